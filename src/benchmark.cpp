@@ -18,12 +18,18 @@
   along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 
+#include <chrono>
 #include <fstream>
+#include <iomanip>
 #include <iostream>
 #include <istream>
 #include <vector>
 
+#include "evaluate.h"
+#include "misc.h"
 #include "position.h"
+#include "thread.h"
+#include "uci.h"
 
 using namespace std;
 
@@ -87,8 +93,503 @@ const vector<string> Defaults = {
   "setoption name UCI_Chess960 value false"
 };
 
+/// nanos() returns a high resolution timestamp for the microbenchmarks
+
+int64_t nanos() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>
+        (std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+
+/// attacks_bench() times attacks_bb() for every piece type in use, comparing
+/// the move class dispatch with the generic lookup of both magics masked with
+/// PseudoAttacks, which is what every piece type used to pay.
+
+void attacks_bench() {
+
+  constexpr int Reps = 400;
+  PRNG rng(1070372);
+  Bitboard occupancies[64];
+  Bitboard sink = 0;
+
+  for (Bitboard& b : occupancies)
+      b = rng.rand<Bitboard>() & rng.rand<Bitboard>();
+
+  cerr << "\nPiece  class  generic ns/call  dispatched ns/call  saving" << endl;
+
+  for (PieceType pt = PAWN; pt < PieceTypeEnd; ++pt)
+  {
+      int64_t t0 = nanos();
+
+      for (int r = 0; r < Reps; ++r)
+          for (Square s = SQ_A1; s <= SQ_H8; ++s)
+              for (Bitboard b : occupancies)
+                  sink += attacks_by_class<ALL_SLIDER | RANGE_LIMITED>(Color(r & 1), pt, s, b);
+
+      int64_t t1 = nanos();
+
+      for (int r = 0; r < Reps; ++r)
+          for (Square s = SQ_A1; s <= SQ_H8; ++s)
+              for (Bitboard b : occupancies)
+                  sink += attacks_bb(Color(r & 1), pt, s, b);
+
+      int64_t t2 = nanos();
+
+      double calls = double(Reps) * SQUARE_NB * 64;
+      double generic = (t1 - t0) / calls, dispatched = (t2 - t1) / calls;
+
+      cerr << setw(5) << PieceToChar[pt] << setw(7) << PieceMoveClass[pt]
+           << fixed << setprecision(2)
+           << setw(17) << generic << setw(20) << dispatched
+           << setw(7) << setprecision(0) << 100 * (1 - dispatched / generic) << "%" << endl;
+  }
+
+  cerr << "Checksum: " << sink << endl;
+}
+
+
+/// SeeCases are captures with their exchange value, in positions where all the
+/// gating pieces are selected. They cover value ordering among the fairy pieces
+/// and X-rays behind compound and range limited sliders.
+
+struct SeeCase {
+  const char* board;
+  const char* move;
+  int value;
+};
+
+const SeeCase SeeCases[] = {
+  { "k7/8/8/3p4/4p3/8/8/4R2K",          "e1e4",  171 - 1282 },              // RxP, PxR
+  { "k7/8/8/3p4/8/8/1N6/7K",            "b2c4", -764 },                     // Hanging knight
+  { "k7/4h3/2c5/4p3/3Q4/8/8/4R2K",      "d4e5",  171 - 2500 + 1537 - 1282 }, // Hawk before Cannon
+  { "k7/6d1/3p4/4r3/8/3N4/4R3/4M2K",    "d3e5",  1282 - 764 + 171 },        // Chancellor behind Rook
+  { "k3r3/8/3p4/4n3/3B4/2LN4/8/7K",     "d3e5",  764 - 764 + 171 },         // Leopard behind Bishop
+  { "k3r3/8/3p4/4n3/3B4/3N4/1F6/7K",    "d3e5",  764 - 764 + 171 },         // Fortress behind Bishop
+};
+
+
+/// see_bench() checks see_ge() on SeeCases at the exchange value and one above
+/// it, then times see_ge() over all the legal moves of the test positions.
+
+void see_bench() {
+
+  const string Gates = "[C-L-A-M-S-D-U-H-E-F-C-L-A-M-c-l-a-m-s-d-u-h-e-f-c-l-a-m-]";
+  constexpr int Reps = 20000;
+  Position pos;
+  StateInfo st;
+  int failures = 0;
+  int64_t elapsed = 0, calls = 0, sink = 0;
+
+  for (const SeeCase& c : SeeCases)
+  {
+      pos.set(c.board + Gates + " w - - 0 1", false, &st, Threads.main());
+      string move = c.move;
+      Move m = UCI::to_move(pos, move);
+
+      if (   m == MOVE_NONE
+          || !pos.see_ge(m, Value(c.value))
+          ||  pos.see_ge(m, Value(c.value + 1)))
+      {
+          cerr << "SEE failed: " << c.board << " " << c.move << " " << c.value << endl;
+          failures++;
+      }
+
+      MoveList<LEGAL> moves(pos);
+      int64_t t0 = nanos();
+
+      for (int r = 0; r < Reps; ++r)
+          for (const ExtMove& em : moves)
+              sink += pos.see_ge(em.move, Value((r & 7) * 200 - 800));
+
+      elapsed += nanos() - t0;
+      calls += int64_t(Reps) * moves.size();
+  }
+
+  cerr << "\nSEE cases failed: " << failures << "/" << sizeof(SeeCases) / sizeof(SeeCase)
+       << "\nSEE ns/call     : " << fixed << setprecision(2) << double(elapsed) / calls
+       << "\nChecksum        : " << sink << endl;
+}
+
+
+/// LegalFuzzFens are the starting points of the random games of legal_fuzz(),
+/// covering gate selection and placement, gated castling, en passant and
+/// promotions to the gating pieces.
+
+const char* LegalFuzzFens[] = {
+  "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+  "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR[C?L?A?M?S?D?U?H?E?F?C?L?A?M?c?l?a?m?s?d?u?h?e?f?c?l?a?m?] w KQkq - 0 1",
+  "r3k2r/pppppppp/8/8/8/8/PPPPPPPP/R3K2R[CeL-A-M-S-D-U-H-E-F-C-L-A-M-chl-a-m-s-d-u-h-e-f-c-l-a-m-] w KQkq - 0 1",
+  "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR[CbLgA-M-S-D-U-H-E-F-C-L-A-M-cblga-m-s-d-u-h-e-f-c-l-a-m-] w KQkq - 0 1",
+  "1n2k3/PPP5/8/3pP3/8/8/ppp5/4K1N1[C-L-A-M-S-D-U-H-E-F-C-L-A-M-c-l-a-m-s-d-u-h-e-f-c-l-a-m-] w - d6 0 2",
+};
+
+
+/// legal_fuzz() plays random games and checks at every node that a move passes
+/// pseudo_legal() and legal() exactly when MoveList<LEGAL> contains it. The
+/// moves tried are the legal ones, moves seen earlier in the game, copies of
+/// the legal ones with another piece type, and random bits. It then times
+/// pseudo_legal() on legal moves of each move type, as for a TT move.
+
+void legal_fuzz() {
+
+  constexpr int Games = 200, MaxPly = 160;
+  constexpr size_t PoolSize = 256;
+  PRNG rng(20181107);
+  Position pos;
+  StateInfo states[MaxPly + 1];
+  vector<Move> pool, tried;
+  int64_t checked = 0, mismatches = 0;
+
+  for (int game = 0; game < Games; ++game)
+  {
+      const char* fen = LegalFuzzFens[game % (sizeof(LegalFuzzFens) / sizeof(char*))];
+      pos.set(fen, false, &states[0], Threads.main());
+
+      for (int ply = 0; ply < MaxPly; ++ply)
+      {
+          MoveList<LEGAL> legals(pos);
+          tried.clear();
+
+          for (const ExtMove& em : legals)
+          {
+              tried.push_back(em.move);
+              tried.push_back(Move((em.move & ~(63 << 6)) | (rng.rand<unsigned>() % PIECE_TYPE_NB) << 6));
+          }
+
+          for (int i = 0; i < 16; ++i)
+              tried.push_back(Move(rng.rand<unsigned>() & 0xFFFF));
+
+          tried.insert(tried.end(), pool.begin(), pool.end());
+
+          for (Move m : tried)
+          {
+              if (!is_ok(m))
+                  continue;
+
+              bool accepted = pos.pseudo_legal(m) && pos.legal(m);
+              if (accepted != legals.contains(m))
+              {
+                  cerr << "pseudo_legal mismatch: " << pos.fen() << " " << UCI::move(m, pos)
+                       << " (" << int(m) << ")" << endl;
+                  mismatches++;
+              }
+              checked++;
+          }
+
+          if (!legals.size())
+              break;
+
+          Move m = legals.begin()[rng.rand<unsigned>() % legals.size()];
+          pool.push_back(m);
+          if (pool.size() > PoolSize)
+              pool.erase(pool.begin());
+
+          pos.do_move(m, states[ply + 1]);
+      }
+  }
+
+  cerr << "\npseudo_legal mismatches: " << mismatches << "/" << checked << endl;
+
+  // Time validation of legal moves per move type, from fresh positions so
+  // that each move is validated where it was generated.
+  const char* TypeNames[] = { "normal", "en passant", "castling", "promotion",
+                              "promotion", "promotion", "set gating", "put gating" };
+  constexpr int Reps = 2000;
+  int64_t sink = 0;
+
+  cerr << "\nMove type    moves  ns/call" << endl;
+
+  for (int t = 0; t < 8; ++t)
+  {
+      int64_t elapsed = 0, calls = 0;
+
+      for (int game = 0; game < int(sizeof(LegalFuzzFens) / sizeof(char*)); ++game)
+      {
+          pos.set(LegalFuzzFens[game], false, &states[0], Threads.main());
+
+          // Walk a few plies so that every phase and move type gets its turn
+          for (int ply = 0; ply < 40; ++ply)
+          {
+              MoveList<LEGAL> legals(pos);
+              vector<Move> moves;
+
+              for (const ExtMove& em : legals)
+                  if (((em.move >> 12) & 7) == t)
+                      moves.push_back(em.move);
+
+              if (!moves.empty())
+              {
+                  int64_t t0 = nanos();
+
+                  for (int r = 0; r < Reps; ++r)
+                      for (Move m : moves)
+                          sink += pos.pseudo_legal(m);
+
+                  elapsed += nanos() - t0;
+                  calls += int64_t(Reps) * moves.size();
+              }
+
+              if (!legals.size())
+                  break;
+
+              pos.do_move(legals.begin()[ply % legals.size()], states[ply + 1]);
+          }
+      }
+
+      if (calls)
+          cerr << left << setw(12) << TypeNames[t] << right << setw(6) << calls / Reps
+               << fixed << setprecision(2) << setw(9) << double(elapsed) / calls << endl;
+  }
+
+  cerr << "Checksum: " << sink << endl;
+}
+
+
+/// make_move_bench() times a do_move() and undo_move() pair on the legal moves
+/// of the bench positions with all the gating pieces selected and a few plies
+/// into the game, and on the gated positions of legal_fuzz(). Moves are split
+/// by whether they can take the do_normal_move() path.
+
+void make_move_bench() {
+
+  const string Gates = "[C-L-A-M-S-D-U-H-E-F-C-L-A-M-c-l-a-m-s-d-u-h-e-f-c-l-a-m-]";
+  const char* KindNames[] = { "normal", "normal, gate", "en passant", "castling", "promotion" };
+  constexpr int Reps = 2000, Plies = 8;
+  Position pos;
+  StateInfo states[Plies + 1], st;
+  vector<string> fens;
+  int64_t elapsed[5] = {}, calls[5] = {}, sink = 0;
+
+  for (const string& cmd : Defaults)
+  {
+      if (cmd.find("setoption") == 0)
+          continue;
+
+      size_t boardEnd = cmd.find_first_of("[ ");
+      size_t fieldsStart = cmd.find(' ', boardEnd);
+      fens.push_back(cmd.substr(0, boardEnd) + Gates + cmd.substr(fieldsStart, cmd.find(" moves") - fieldsStart));
+  }
+
+  fens.push_back(LegalFuzzFens[2]);
+  fens.push_back(LegalFuzzFens[3]);
+
+  for (const string& fen : fens)
+  {
+      pos.set(fen, false, &states[0], Threads.main());
+
+      for (int ply = 0; ply < Plies; ++ply)
+      {
+          MoveList<LEGAL> legals(pos);
+
+          for (const ExtMove& em : legals)
+          {
+              Move m = em.move;
+              bool givesCheck = pos.gives_check(m);
+              int kind =  type_of(m) == ENPASSANT ? 2
+                        : type_of(m) == CASTLING  ? 3
+                        : type_of(m) == PROMOTION ? 4
+                        : (pos.gates() & (SquareBB[from_sq(m)] | to_sq(m))) ? 1 : 0;
+
+              int64_t t0 = nanos();
+
+              for (int r = 0; r < Reps; ++r)
+              {
+                  pos.do_move(m, st, givesCheck);
+                  sink += st.key;
+                  pos.undo_move(m);
+              }
+
+              elapsed[kind] += nanos() - t0;
+              calls[kind] += Reps;
+          }
+
+          if (!legals.size())
+              break;
+
+          pos.do_move(legals.begin()[ply * 7 % legals.size()], states[ply + 1]);
+      }
+  }
+
+  cerr << "\nMove kind       moves  ns/make+unmake" << endl;
+
+  for (int kind = 0; kind < 5; ++kind)
+      if (calls[kind])
+          cerr << left << setw(14) << KindNames[kind] << right << setw(7) << calls[kind] / Reps
+               << fixed << setprecision(2) << setw(16) << double(elapsed[kind]) / calls[kind] << endl;
+
+  cerr << "Checksum: " << sink << endl;
+}
+
+
+/// EvalFens have fairy pieces on the board and on gates. eval_bench() walks a
+/// few plies from each of them.
+
+const char* EvalFens[] = {
+  "r1bqkbnr/pppppppp/2c1l3/8/3U4/2H1E3/PPPPPPPP/RNBQKBNR[C-L-A-M-S-D-U-H-E-F-C-L-A-M-c-l-a-m-s-d-u-h-e-f-c-l-a-m-] w KQkq - 0 1",
+  "4k3/1s1d4/2f5/8/3M4/1A3L2/8/4K3[C-L-A-M-S-D-U-H-E-F-C-L-A-M-c-l-a-m-s-d-u-h-e-f-c-l-a-m-] w - - 0 1",
+  "r3k2r/ppp2ppp/2nbbn2/3pp3/3PP3/2NBBN2/PPP2PPP/R3K2R[UeEbA-M-S-D-U-H-E-F-C-L-A-M-ufeba-m-s-d-u-h-e-f-c-l-a-m-] w KQkq - 0 1",
+  "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR[CbLgA-M-S-D-U-H-E-F-C-L-A-M-cblga-m-s-d-u-h-e-f-c-l-a-m-] w KQkq - 0 1",
+};
+
+
+/// SetwiseLeap is one leap of a piece type applied to a whole bitboard: the
+/// squares it would leave the board from are masked out, then it is shifted.
+
+struct SetwiseLeap {
+  int shift;
+  Bitboard mask;
+};
+
+int setwise_leaps(Color c, PieceType pt, SetwiseLeap* leaps) {
+
+  int n = 0;
+
+  for (Bitboard b = LeaperAttacks[c][pt][SQ_D4]; b; ++n)
+  {
+      Square to = pop_lsb(&b);
+      int df = file_of(to) - FILE_D, dr = rank_of(to) - RANK_4;
+
+      leaps[n].shift = 8 * dr + df;
+      leaps[n].mask = 0;
+
+      for (Square s = SQ_A1; s <= SQ_H8; ++s)
+          if (   file_of(s) + df >= FILE_A && file_of(s) + df <= FILE_H
+              && rank_of(s) + dr >= RANK_1 && rank_of(s) + dr <= RANK_8)
+              leaps[n].mask |= s;
+  }
+
+  return n;
+}
+
+Bitboard setwise_attacks(const SetwiseLeap* leaps, int n, Bitboard b) {
+
+  Bitboard att = 0;
+
+  for (int i = 0; i < n; ++i)
+      att |= leaps[i].shift > 0 ? (b & leaps[i].mask) <<  leaps[i].shift
+                                : (b & leaps[i].mask) >> -leaps[i].shift;
+  return att;
+}
+
+
+/// eval_bench() times Eval::evaluate() on positions with fairy pieces, and for
+/// the pure leapers among them compares filling the attacks of all pieces of a
+/// type from per-square lookups, as the evaluation does, with a setwise fill
+/// that shifts the whole bitboard once per leap.
+
+void eval_bench() {
+
+  constexpr int Reps = 2000, Plies = 24;
+  const PieceType Leapers[] = { CANNON, UNICORN, HAWK, ELEPHANT };
+  PRNG rng(20181107);
+  Position pos;
+  StateInfo states[Plies + 1];
+  SetwiseLeap leaps[COLOR_NB][PIECE_TYPE_NB][24];
+  int leapCount[COLOR_NB][PIECE_TYPE_NB];
+  int64_t evalTime = 0, evals = 0, lookupTime = 0, setwiseTime = 0, fills = 0, mismatches = 0;
+  Bitboard sink = 0;
+
+  for (Color c = WHITE; c <= BLACK; ++c)
+      for (PieceType pt : Leapers)
+          leapCount[c][pt] = setwise_leaps(c, pt, leaps[c][pt]);
+
+  for (const char* fen : EvalFens)
+  {
+      pos.set(fen, false, &states[0], Threads.main());
+
+      for (int ply = 0; ply < Plies; ++ply)
+      {
+          MoveList<LEGAL> legals(pos);
+
+          if (!legals.size())
+              break;
+
+          if (!pos.checkers())
+          {
+              int64_t t0 = nanos();
+
+              for (int r = 0; r < Reps; ++r)
+                  sink += Eval::evaluate(pos);
+
+              evalTime += nanos() - t0;
+              evals += Reps;
+
+              for (Color c = WHITE; c <= BLACK; ++c)
+                  for (PieceType pt : Leapers)
+                  {
+                      if (!pos.pieces(c, pt))
+                          continue;
+
+                      Bitboard lookup = 0, setwise = 0;
+                      t0 = nanos();
+
+                      for (int r = 0; r < Reps; ++r)
+                      {
+                          lookup = 0;
+                          for (const Square* s = pos.squares(c, pt); *s != SQ_NONE; ++s)
+                              lookup |= pos.attacks_from(c, pt, *s);
+                          sink += lookup;
+                      }
+
+                      int64_t t1 = nanos();
+
+                      for (int r = 0; r < Reps; ++r)
+                      {
+                          setwise = setwise_attacks(leaps[c][pt], leapCount[c][pt], pos.pieces(c, pt));
+                          sink += setwise;
+                      }
+
+                      lookupTime += t1 - t0;
+                      setwiseTime += nanos() - t1;
+                      fills += Reps;
+                      mismatches += lookup != setwise;
+                  }
+          }
+
+          pos.do_move(legals.begin()[rng.rand<unsigned>() % legals.size()], states[ply + 1]);
+      }
+  }
+
+  cerr << "\nEvaluations/second : " << 1000000000 * evals / std::max(evalTime, int64_t(1))
+       << fixed << setprecision(2)
+       << "\nns/evaluation      : " << double(evalTime) / evals
+       << "\nLeaper fills       : " << fills / Reps << " (" << mismatches << " mismatches)"
+       << "\nns/fill by lookups : " << double(lookupTime) / std::max(fills, int64_t(1))
+       << "\nns/fill setwise    : " << double(setwiseTime) / std::max(fills, int64_t(1))
+       << "\nChecksum: " << sink << endl;
+}
+
 } // namespace
 
+
+/// microbench() runs one of the debug microbenchmarks selected by its first
+/// argument:
+///
+/// microbench attacks  -> time attacks_bb() per piece type
+/// microbench see      -> check see_ge() on known exchanges and time it
+/// microbench legal    -> cross-check pseudo_legal() with MoveList<LEGAL> in random games
+/// microbench makemove -> time do_move() + undo_move() per kind of move
+/// microbench eval     -> time evaluate() and setwise leaper attack fills
+
+void microbench(istream& is) {
+
+  string token;
+  is >> token;
+
+  if (token == "attacks")
+      attacks_bench();
+  else if (token == "see")
+      see_bench();
+  else if (token == "legal")
+      legal_fuzz();
+  else if (token == "makemove")
+      make_move_bench();
+  else if (token == "eval")
+      eval_bench();
+  else
+      cerr << "Unknown microbenchmark: " << token << endl;
+}
+
 /// setup_bench() builds a list of UCI commands to be run by bench. There
 /// are five parameters: TT size in MB, number of search threads that
 /// should be used, the limit value spent for each position, a file name
@@ -2,9 +2,14 @@
 #include "bitboard.h"
 #include <algorithm>
 #include <cctype>
+#include <cstdlib>
 #include <sstream>
 #include <iostream>
 
+namespace PSQT {
+  void init();
+}
+
 namespace Betza {
 
 // Global instance
@@ -22,28 +27,39 @@ void BetzaManager::init() {
     // Clear existing pieces
     pieces.clear();
     pieceTypes.clear();
+
+    // Release the custom piece types together with their attack tables
+    for (PieceType pt = CUSTOM_1; pt < PieceTypeEnd; ++pt) {
+        Bitboards::init_piece(pt, CompiledMoves());
+        PieceValue[MG][make_piece(WHITE, pt)] = PieceValue[EG][make_piece(WHITE, pt)] = VALUE_ZERO;
+    }
+    PieceTypeEnd = CUSTOM_1;
+    PSQT::init();
     
     // Add standard chess pieces
-    addPiece("Pawn", "mWfceFifmnD", Value(171), Value(240));
-    addPiece("Knight", "N", Value(764), Value(848));
-    addPiece("Bishop", "B", Value(826), Value(891));
-    addPiece("Rook", "R", Value(1282), Value(1373));
-    addPiece("Queen", "Q", Value(2500), Value(2670));
-    addPiece("King", "KisO2", Value(0), Value(0));
+    definePiece("Pawn", "mWfceFifmnD", Value(171), Value(240));
+    definePiece("Knight", "N", Value(764), Value(848));
+    definePiece("Bishop", "B", Value(826), Value(891));
+    definePiece("Rook", "R", Value(1282), Value(1373));
+    definePiece("Queen", "Q", Value(2500), Value(2670));
+    definePiece("King", "KisO2", Value(0), Value(0));
     
     // Add Musketeer pieces with their Betza notation
-    addPiece("Cannon", "llNrrNDK", Value(1710), Value(2239));
-    addPiece("Leopard", "NB2", Value(1648), Value(2014));
-    addPiece("Archbishop", "BN", Value(2036), Value(2202));
-    addPiece("Chancellor", "RN", Value(2251), Value(2344));
-    addPiece("Spider", "B2DN", Value(2321), Value(2718));
-    addPiece("Dragon", "QN", Value(3280), Value(2769));
-    addPiece("Unicorn", "CN", Value(1584), Value(1772));
-    addPiece("Hawk", "DHAG", Value(1537), Value(1561));
-    addPiece("Elephant", "KDA", Value(1770), Value(2000));
-    addPiece("Fortress", "B3DfNbN", Value(1956), Value(2100));
+    definePiece("Cannon", "llNrrNDK", Value(1710), Value(2239));
+    definePiece("Leopard", "NB2", Value(1648), Value(2014));
+    definePiece("Archbishop", "BN", Value(2036), Value(2202));
+    definePiece("Chancellor", "RN", Value(2251), Value(2344));
+    definePiece("Spider", "B2DN", Value(2321), Value(2718));
+    definePiece("Dragon", "QN", Value(3280), Value(2769));
+    definePiece("Unicorn", "CN", Value(1584), Value(1772));
+    definePiece("Hawk", "DHAG", Value(1537), Value(1561));
+    definePiece("Elephant", "KDA", Value(1770), Value(2000));
+    definePiece("Fortress", "B3DfNbN", Value(1956), Value(2100));
     
-    // Map to piece types
+    // Map to piece types. Built-in pieces keep their hand-tuned tables.
+    for (auto& pair : pieces)
+        pair.second.type = betzaToPieceType(pair.second.moves[0].notation);
+
     pieceTypes[PAWN] = pieces["Pawn"];
     pieceTypes[KNIGHT] = pieces["Knight"];
     pieceTypes[BISHOP] = pieces["Bishop"];
@@ -127,19 +143,46 @@ BetzaMove BetzaManager::parseBetzaNotation(const std::string& notation) {
     return move;
 }
 
-void BetzaManager::addPiece(const std::string& name, const std::string& betzaNotation, 
-                           Value mgValue, Value egValue) {
+BetzaPiece& BetzaManager::definePiece(const std::string& name, const std::string& betzaNotation,
+                                      Value mgValue, Value egValue) {
     BetzaPiece piece;
     piece.name = name;
     piece.symbol = name.substr(0, 1);
     piece.midgameValue = mgValue;
     piece.endgameValue = egValue;
-    piece.isCustom = true;
-    
+
     // Parse the Betza notation into moves
     piece.moves.push_back(parseBetzaNotation(betzaNotation));
-    
-    pieces[name] = piece;
+    piece.compiled = compileBetza(betzaNotation);
+
+    return pieces[name] = piece;
+}
+
+PieceType BetzaManager::addPiece(const std::string& name, const std::string& betzaNotation,
+                                 Value mgValue, Value egValue) {
+    // A redefinition reuses the piece type already bound to the name
+    BetzaPiece* old = getPiece(name);
+    PieceType pt = old && old->isCustom ? old->type : PieceTypeEnd;
+
+    if (pt == PIECE_TYPE_NB)
+        return NO_PIECE_TYPE;
+
+    BetzaPiece& piece = definePiece(name, betzaNotation, mgValue, egValue);
+    piece.isCustom = true;
+    piece.type = pt;
+
+    // Compile the movement once into the tables used by attacks_bb(), so that
+    // the piece costs the same as a built-in one during search.
+    Bitboards::init_piece(pt, piece.compiled);
+    PieceValue[MG][make_piece(WHITE, pt)] = mgValue;
+    PieceValue[EG][make_piece(WHITE, pt)] = egValue;
+    if (pt == PieceTypeEnd)
+        ++PieceTypeEnd;
+
+    PSQT::init();
+
+    pieceTypes[pt] = piece;
+    return pt;
 }
 
 BetzaPiece* BetzaManager::getPiece(const std::string& name) {
@@ -378,6 +421,117 @@ PieceType betzaToPieceType(const std::string& betza) {
     return NO_PIECE_TYPE;
 }
 
+/// compileBetza() translates a Betza notation into the leaps and slides of the
+/// native attack tables. Atoms are the leapers W, F, D, N, A, H, C, Z, G and
+/// the compounds K, B, R, Q. A doubled W or F, or any W/F with a range, is a
+/// slider; a range of 0 means unlimited. Other riders, which can not be looked
+/// up with magics, are reduced to their first leap. Direction modifiers f, b, l, r, v, s
+/// (doubled for the narrow variant, and f/b followed by l/r for a quadrant)
+/// restrict the atom that follows. Modifiers that an attack table can not
+/// express, like move or capture only, and the castling atom O are ignored.
+CompiledMoves compileBetza(const std::string& notation) {
+
+    CompiledMoves cm;
+    std::string mods;
+
+    auto keep = [&](int dx, int dy) {
+        if (mods.empty())
+            return true;
+
+        for (size_t i = 0; i < mods.size(); ++i)
+        {
+            char m = mods[i];
+            bool twice = i + 1 < mods.size() && mods[i + 1] == m;
+            bool quadrant = (m == 'f' || m == 'b') && i + 1 < mods.size()
+                          && (mods[i + 1] == 'l' || mods[i + 1] == 'r');
+            bool ok =  m == 'f' ? dy > 0 && (!twice || abs(dy) > abs(dx))
+                     : m == 'b' ? dy < 0 && (!twice || abs(dy) > abs(dx))
+                     : m == 'l' ? dx < 0 && (!twice || abs(dx) > abs(dy))
+                     : m == 'r' ? dx > 0 && (!twice || abs(dx) > abs(dy))
+                     : m == 'v' ? abs(dy) > abs(dx)
+                     : m == 's' ? abs(dx) > abs(dy) : false;
+
+            if (quadrant)
+                ok = ok && (mods[i + 1] == 'l' ? dx < 0 : dx > 0);
+
+            if (ok)
+                return true;
+
+            i += twice || quadrant;
+        }
+        return false;
+    };
+
+    auto add = [&](int a, int b, int range) {
+        for (int dx : { -a, a, -b, b })
+            for (int dy : { -a, a, -b, b })
+            {
+                if (   std::max(abs(dx), abs(dy)) != a
+                    || std::min(abs(dx), abs(dy)) != b
+                    || !keep(dx, dy))
+                    continue;
+
+                Direction d = Direction(8 * dy + dx);
+
+                if (range > 1 && a == 1)
+                {
+                    if (std::find_if(cm.slides.begin(), cm.slides.end(),
+                                     [d](const std::pair<Direction, int>& sl) { return sl.first == d; }) == cm.slides.end())
+                        cm.slides.emplace_back(d, range);
+                }
+                else if (std::find(cm.leaps.begin(), cm.leaps.end(), d) == cm.leaps.end())
+                    cm.leaps.push_back(d);
+            }
+    };
+
+    for (size_t i = 0; i < notation.size(); ++i)
+    {
+        char c = notation[i];
+
+        if (islower(c))
+        {
+            mods += c;
+            continue;
+        }
+
+        if (!isupper(c))
+            continue;
+
+        // Range suffix: a doubled atom or a number, 0 if not given
+        int range = 0;
+        if (i + 1 < notation.size() && notation[i + 1] == c)
+            range = 7, ++i;
+        if (i + 1 < notation.size() && isdigit(notation[i + 1]))
+        {
+            range = notation[++i] - '0';
+            range = range ? std::min(range, 7) : 7;
+        }
+
+        int riderRange = range ? range : 7;
+
+        switch (c)
+        {
+        case 'W': add(1, 0, range); break;
+        case 'F': add(1, 1, range); break;
+        case 'D': add(2, 0, 1); break;
+        case 'N': add(2, 1, 1); break;
+        case 'A': add(2, 2, 1); break;
+        case 'H': add(3, 0, 1); break;
+        case 'C': add(3, 1, 1); break;
+        case 'Z': add(3, 2, 1); break;
+        case 'G': add(3, 3, 1); break;
+        case 'K': add(1, 0, range); add(1, 1, range); break;
+        case 'B': add(1, 1, riderRange); break;
+        case 'R': add(1, 0, riderRange); break;
+        case 'Q': add(1, 0, riderRange); add(1, 1, riderRange); break;
+        default: break;
+        }
+        mods.clear();
+    }
+
+    return cm;
+}
+
 bool isValidBetzaNotation(const std::string& notation) {
     // Basic validation - check for valid characters
     for (char c : notation) {
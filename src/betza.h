@@ -5,6 +5,7 @@
 #include <vector>
 #include <map>
 #include <unordered_map>
+#include <utility>
 #include "types.h"
 
 // Forward declare Betza namespace types (only what's needed)
@@ -70,13 +71,22 @@ struct BetzaMove {
     std::string notation;
 };
 
+// Native movement of a piece as used by the attack tables: leap steps and
+// range limited slide directions, both from White's point of view.
+struct CompiledMoves {
+    std::vector<Direction> leaps;
+    std::vector<std::pair<Direction, int>> slides;
+};
+
 // Piece definition with multiple movement patterns
 struct BetzaPiece {
     std::string name;
     std::string symbol;
     std::vector<BetzaMove> moves;
+    CompiledMoves compiled;
     Value midgameValue;
     Value endgameValue;
+    PieceType type = NO_PIECE_TYPE;
     bool isCustom = false;
 };
 
@@ -97,9 +107,10 @@ public:
     // Parse Betza notation
     BetzaMove parseBetzaNotation(const std::string& notation);
     
-                   // Add custom piece
-               void addPiece(const std::string& name, const std::string& betzaNotation,
-                             Value mgValue = PawnValueMg, Value egValue = PawnValueEg);
+    // Add custom piece, compiled into the attack tables of a CUSTOM_n type.
+    // Returns NO_PIECE_TYPE if all the custom piece types are in use.
+    PieceType addPiece(const std::string& name, const std::string& betzaNotation,
+                       Value mgValue = PawnValueMg, Value egValue = PawnValueEg);
     
     // Get piece by name
     BetzaPiece* getPiece(const std::string& name);
@@ -126,6 +137,10 @@ public:
     std::string getPieceString() const;
     
 private:
+    // Register a piece definition without binding it to a piece type
+    BetzaPiece& definePiece(const std::string& name, const std::string& betzaNotation,
+                            Value mgValue, Value egValue);
+
     // Helper functions for parsing
     Direction parseDirection(char c);
     std::vector<Direction> parseDirections(const std::string& dirs);
@@ -145,6 +160,7 @@ extern BetzaManager betzaManager;
 std::string pieceTypeToBetza(PieceType pt);
 PieceType betzaToPieceType(const std::string& betza);
 bool isValidBetzaNotation(const std::string& notation);
+CompiledMoves compileBetza(const std::string& notation);
 
 } // namespace Betza
 
@@ -19,12 +19,16 @@
 */
 
 #include <algorithm>
+#include <atomic>
 #include <cassert>
+#include <mutex>
 #include <numeric>
+#include <thread>
 #include <vector>
 
 #include "bitboard.h"
 #include "types.h"
+#include "uci.h"
 
 namespace {
 
@@ -70,6 +74,62 @@ namespace {
     Result result;
   };
 
+  // KXK and KXKP bitbases, X being any built-in fairy piece. With the side of
+  // X as white, an index is laid out as:
+  //
+  // bit  0- 5: white king square (from SQ_A1 to SQ_H8)
+  // bit  6-11: black king square (from SQ_A1 to SQ_H8)
+  // bit 12-17: square of X (from SQ_A1 to SQ_H8)
+  // bit    18: side to move (WHITE or BLACK)
+  // bit 19-24: black pawn square - SQ_A2 (from SQ_A2 to SQ_H7), KXKP only
+  constexpr unsigned KXK_MAX_INDEX  = 2*64*64*64;     // stm * xsq * bksq * wksq = 524288
+  constexpr unsigned KXKP_MAX_INDEX = 48*KXK_MAX_INDEX; // psq * KXK index = 25165824
+
+  unsigned kxk_index(Color us, Square bksq, Square wksq, Square xsq, Square psq = SQ_A2) {
+    return wksq | (bksq << 6) | (xsq << 12) | (us << 18) | ((psq - SQ_A2) << 19);
+  }
+
+  // The bitbases are never freed, so that a KXKP build running in the
+  // background when the program exits does not use destroyed objects.
+  std::atomic<uint32_t*> KXKBitbase[KING];
+  std::once_flag KXKBuilt[KING];
+  std::atomic_flag KXKStarted[KING] = {};
+  std::atomic<uint32_t*> KXKPBitbase[KING];
+  std::atomic_flag KXKPStarted[KING] = {};
+
+  // kxk_win() looks up a KXK bitbase that is known to be built
+  bool kxk_win(PieceType pt, Square wksq, Square xsq, Square bksq, Color us) {
+    unsigned idx = kxk_index(us, bksq, wksq, xsq);
+    return KXKBitbase[pt].load(std::memory_order_relaxed)[idx / 32] & (1 << (idx & 0x1F));
+  }
+
+  // KXKBuilder classifies the KXK or KXKP positions of a piece type from its
+  // attack tables, iterating to a fixed point like the KPK code. Each pass is
+  // split among threads. A result only changes from UNKNOWN to final, so the
+  // threads may read each other's results while a pass runs.
+  //
+  // A black pawn promotion, or a capture of X, counts as a DRAW: the results
+  // tell whether X wins, and a WIN is exact.
+  struct KXKBuilder {
+    KXKBuilder(PieceType pt, bool pawn, unsigned threads)
+      : X(pt), withPawn(pawn), threadCount(threads), size(pawn ? KXKP_MAX_INDEX : KXK_MAX_INDEX), db(size) {}
+
+    Result initial(unsigned idx) const;
+    Result classify(unsigned idx) const;
+    uint32_t* build();
+
+    template<typename F> void parallel_for(F fn) const;
+
+    const PieceType X;
+    const bool withPawn;
+    const unsigned threadCount, size;
+    std::vector<std::atomic<Result>> db;
+  };
+
+  void build_kxk(PieceType pt, unsigned threads) {
+    KXKBitbase[pt].store(KXKBuilder(pt, false, threads).build(), std::memory_order_release);
+  }
+
 } // namespace
 
 
@@ -82,6 +142,64 @@ bool Bitbases::probe(Square wksq, Square wpsq, Square bksq, Color us) {
 }
 
 
+/// Bitbases::probe() for KXK tells in 'win' whether the side with the fairy
+/// piece X wins, with that side as white. Like for KXKP, the first call starts
+/// building the bitbase for X in the background, so that no search thread
+/// waits for it, and the probes return false until it is ready.
+
+bool Bitbases::probe(PieceType pt, Square wksq, Square xsq, Square bksq, Color us, bool& win) {
+
+  assert(pt > QUEEN && pt < KING);
+
+  if (!KXKBitbase[pt].load(std::memory_order_acquire))
+  {
+      if (!KXKStarted[pt].test_and_set())
+      {
+          unsigned threads = std::max(1u, unsigned(Options["Threads"]));
+          std::thread([pt, threads]() {
+              std::call_once(KXKBuilt[pt], build_kxk, pt, threads);
+          }).detach();
+      }
+      return false;
+  }
+
+  win = kxk_win(pt, wksq, xsq, bksq, us);
+  return true;
+}
+
+
+/// Bitbases::probe() for KXKP tells in 'win' whether the side with the fairy
+/// piece X wins against the pawn on 'psq', with that side as white. Building
+/// this bitbase takes seconds, so the first call starts it in the background
+/// and the probes return false until it is ready.
+
+bool Bitbases::probe(PieceType pt, Square wksq, Square xsq, Square bksq, Square psq, Color us, bool& win) {
+
+  assert(pt > QUEEN && pt < KING);
+  assert(rank_of(psq) >= RANK_2 && rank_of(psq) <= RANK_7);
+
+  uint32_t* bitbase = KXKPBitbase[pt].load(std::memory_order_acquire);
+
+  if (!bitbase)
+  {
+      if (!KXKPStarted[pt].test_and_set())
+      {
+          unsigned threads = std::max(1u, unsigned(Options["Threads"]));
+          std::thread([pt, threads]() {
+              // Captures of the pawn lead to KXK
+              std::call_once(KXKBuilt[pt], build_kxk, pt, threads);
+              KXKPBitbase[pt].store(KXKBuilder(pt, true, threads).build(), std::memory_order_release);
+          }).detach();
+      }
+      return false;
+  }
+
+  unsigned idx = kxk_index(us, bksq, wksq, xsq, psq);
+  win = bitbase[idx / 32] & (1 << (idx & 0x1F));
+  return true;
+}
+
+
 void Bitbases::init() {
 
   std::vector<KPKPosition> db(MAX_INDEX);
@@ -177,4 +295,165 @@ namespace {
     return result = r & Good  ? Good  : r & UNKNOWN ? UNKNOWN : Bad;
   }
 
+
+  Result KXKBuilder::initial(unsigned idx) const {
+
+    Square wksq = Square((idx >>  0) & 0x3F);
+    Square bksq = Square((idx >>  6) & 0x3F);
+    Square xsq  = Square((idx >> 12) & 0x3F);
+    Color  us   = Color ((idx >> 18) & 0x01);
+    Square psq  = Square((idx >> 19) + SQ_A2);
+    Bitboard pawn = withPawn ? SquareBB[psq] : 0;
+
+    // Check if two pieces are on the same square or if a king can be captured
+    if (   distance(wksq, bksq) <= 1
+        || xsq == wksq
+        || xsq == bksq
+        || (pawn & (SquareBB[wksq] | bksq | xsq))
+        || (us == WHITE && (attacks_bb(WHITE, X, xsq, SquareBB[wksq] | bksq | pawn) & bksq))
+        || (us == BLACK && withPawn && (PseudoAttacks[BLACK][PAWN][psq] & wksq)))
+        return INVALID;
+
+    if (us == WHITE)
+        return UNKNOWN;
+
+    // Immediate draw if the black king captures an undefended X. The squares
+    // behind the black king on the line of a slider are attacked too.
+    Bitboard attacked = PseudoAttacks[WHITE][KING][wksq] | attacks_bb(WHITE, X, xsq, SquareBB[wksq] | pawn);
+
+    if (PseudoAttacks[BLACK][KING][bksq] & xsq & ~attacked)
+        return DRAW;
+
+    if (withPawn)
+    {
+        // Immediate draw if the pawn captures X, or promotes without leaving
+        // the black king in check
+        Square to = psq + SOUTH;
+
+        if (PseudoAttacks[BLACK][PAWN][psq] & xsq)
+            return DRAW;
+
+        if (   rank_of(to) == RANK_1
+            && !(SquareBB[to] & (SquareBB[wksq] | bksq | xsq))
+            && !(attacks_bb(WHITE, X, xsq, SquareBB[wksq] | bksq | to) & bksq))
+            return DRAW;
+    }
+
+    return UNKNOWN;
+  }
+
+  Result KXKBuilder::classify(unsigned idx) const {
+
+    // Same rules as for KPKPosition::classify(): white needs one move to a WIN,
+    // black needs one move to a DRAW. Moves into check lead to INVALID positions.
+    Square wksq = Square((idx >>  0) & 0x3F);
+    Square bksq = Square((idx >>  6) & 0x3F);
+    Square xsq  = Square((idx >> 12) & 0x3F);
+    Color  us   = Color ((idx >> 18) & 0x01);
+    Square psq  = Square((idx >> 19) + SQ_A2);
+    Bitboard pawn = withPawn ? SquareBB[psq] : 0;
+    Bitboard occupied = SquareBB[wksq] | bksq | pawn;
+
+    Result r = INVALID;
+
+    if (us == WHITE)
+    {
+        // Capturing the pawn leads to a KXK position, if it is legal
+        Bitboard b = PseudoAttacks[WHITE][KING][wksq] & ~SquareBB[xsq];
+        while (b)
+        {
+            Square to = pop_lsb(&b);
+            r |=  to != psq || !withPawn ? db[kxk_index(BLACK, bksq, to, xsq, psq)].load(std::memory_order_relaxed)
+                : distance(to, bksq) <= 1 ? INVALID
+                : kxk_win(X, to, xsq, bksq, BLACK) ? WIN : DRAW;
+        }
+
+        b = attacks_bb(WHITE, X, xsq, occupied) & ~(SquareBB[wksq] | bksq);
+        while (b)
+        {
+            Square to = pop_lsb(&b);
+            r |=  to != psq || !withPawn ? db[kxk_index(BLACK, bksq, wksq, to, psq)].load(std::memory_order_relaxed)
+                : kxk_win(X, wksq, to, bksq, BLACK) ? WIN : DRAW;
+        }
+
+        return r & WIN ? WIN : r & UNKNOWN ? UNKNOWN : DRAW;
+    }
+
+    Bitboard b = PseudoAttacks[BLACK][KING][bksq] & ~pawn;
+    while (b)
+        r |= db[kxk_index(WHITE, pop_lsb(&b), wksq, xsq, psq)].load(std::memory_order_relaxed);
+
+    // Pawn pushes that do not promote, promotions are handled by initial()
+    if (withPawn && rank_of(psq) > RANK_2 && !((occupied | xsq) & (psq + SOUTH)))
+    {
+        r |= db[kxk_index(WHITE, bksq, wksq, xsq, psq + SOUTH)].load(std::memory_order_relaxed);
+
+        if (rank_of(psq) == RANK_7 && !((occupied | xsq) & (psq + 2 * SOUTH)))
+            r |= db[kxk_index(WHITE, bksq, wksq, xsq, psq + 2 * SOUTH)].load(std::memory_order_relaxed);
+    }
+
+    // Without a legal move it is mate or stalemate
+    if (r == INVALID)
+        return attacks_bb(WHITE, X, xsq, occupied) & bksq ? WIN : DRAW;
+
+    return r & DRAW ? DRAW : r & UNKNOWN ? UNKNOWN : WIN;
+  }
+
+  template<typename F>
+  void KXKBuilder::parallel_for(F fn) const {
+
+    // Run fn(begin, end) on each thread's share of the positions
+    const unsigned stride = size / threadCount + 1;
+    std::vector<std::thread> threads;
+
+    for (unsigned i = 0; i < threadCount; ++i)
+        threads.emplace_back(fn, std::min(size, i * stride), std::min(size, (i + 1) * stride));
+
+    for (std::thread& th : threads)
+        th.join();
+  }
+
+  uint32_t* KXKBuilder::build() {
+
+#ifndef NDEBUG
+    // The bitbases are probed with the squares flipped when X belongs to black
+    for (Square s = SQ_A1; s <= SQ_H8; ++s)
+        for (Square t = SQ_A1; t <= SQ_H8; ++t)
+            assert(   bool(PseudoAttacks[WHITE][X][s] & t) == bool(PseudoAttacks[BLACK][X][~s] & ~t)
+                   && bool(LeaperAttacks[WHITE][X][s] & t) == bool(LeaperAttacks[BLACK][X][~s] & ~t));
+#endif
+
+    parallel_for([&](unsigned begin, unsigned end) {
+        for (unsigned idx = begin; idx < end; ++idx)
+            db[idx].store(initial(idx), std::memory_order_relaxed);
+    });
+
+    std::atomic<bool> repeat(true);
+
+    while (repeat)
+    {
+        repeat = false;
+        parallel_for([&](unsigned begin, unsigned end) {
+            bool changed = false;
+            for (unsigned idx = begin; idx < end; ++idx)
+                if (db[idx].load(std::memory_order_relaxed) == UNKNOWN)
+                {
+                    Result r = classify(idx);
+                    if (r != UNKNOWN)
+                        db[idx].store(r, std::memory_order_relaxed), changed = true;
+                }
+            if (changed)
+                repeat = true;
+        });
+    }
+
+    // Map 32 results into one bitbase entry, the unknown ones are draws
+    uint32_t* bitbase = new uint32_t[size / 32]();
+    for (unsigned idx = 0; idx < size; ++idx)
+        if (db[idx].load(std::memory_order_relaxed) == WIN)
+            bitbase[idx / 32] |= 1 << (idx & 0x1F);
+
+    return bitbase;
+  }
+
 } // namespace
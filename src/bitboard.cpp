@@ -19,6 +19,7 @@
 */
 
 #include <algorithm>
+#include <iterator>
 
 #include "bitboard.h"
 #include "misc.h"
@@ -40,6 +41,16 @@ Bitboard PawnAttackSpan[COLOR_NB][SQUARE_NB];
 Bitboard PseudoAttacks[COLOR_NB][PIECE_TYPE_NB][SQUARE_NB];
 Bitboard LeaperAttacks[COLOR_NB][PIECE_TYPE_NB][SQUARE_NB];
 
+MoveClass PieceMoveClass[PIECE_TYPE_NB];
+PieceType PieceTypeEnd = CUSTOM_1;
+
+Bitboard ComponentAttacks[COMPONENT_NB][SQUARE_NB];
+ComponentKind ComponentKinds[COMPONENT_NB];
+int ComponentNb;
+uint64_t PieceComponents[PIECE_TYPE_NB];
+PieceType IrregularTypes[PIECE_TYPE_NB];
+int ComponentGeneration;
+
 Magic RookMagics[SQUARE_NB];
 Magic BishopMagics[SQUARE_NB];
 
@@ -49,6 +60,8 @@ namespace {
   Bitboard BishopTable[0x1480]; // To store bishop attacks
 
   void init_magics(Bitboard table[], Magic magics[], Direction directions[]);
+  MoveClass move_class(PieceType pt);
+  void init_components();
 
   // popcount16() counts the non-zero bits using SWAR-Popcount algorithm
 
@@ -232,6 +245,14 @@ void Bitboards::init() {
               PseudoAttacks[c][pt][s] |= sliding_attack(slider[pt], s, 0, slider_dist[pt]);
           }
 
+  for (PieceType pt = NO_PIECE_TYPE; pt <= KING; ++pt)
+  {
+      PieceMoveClass[pt] = move_class(pt);
+      assert(PieceMoveClass[pt] == BuiltinMoveClass[pt]);
+  }
+
+  init_components();
+
   for (Square s1 = SQ_A1; s1 <= SQ_H8; ++s1)
   {
       for (PieceType pt : { BISHOP, ROOK })
@@ -247,8 +268,233 @@ void Bitboards::init() {
 }
 
 
+/// Bitboards::init_piece() fills the attack tables of the given piece type from
+/// its compiled Betza moves. Steps are negated for Black, like the built-in ones.
+
+void Bitboards::init_piece(PieceType pt, const Betza::CompiledMoves& cm) {
+
+  for (Color c = WHITE; c <= BLACK; ++c)
+      for (Square s = SQ_A1; s <= SQ_H8; ++s)
+      {
+          LeaperAttacks[c][pt][s] = PseudoAttacks[c][pt][s] = 0;
+
+          for (Direction d : cm.leaps)
+          {
+              Square to = s + (c == WHITE ? d : -d);
+
+              if (is_ok(to) && distance(s, to) < 4)
+              {
+                  PseudoAttacks[c][pt][s] |= to;
+                  LeaperAttacks[c][pt][s] |= to;
+              }
+          }
+
+          for (const auto& sl : cm.slides)
+          {
+              Direction dirs[2] = { c == WHITE ? sl.first : -sl.first };
+              PseudoAttacks[c][pt][s] |= sliding_attack(dirs, s, 0, sl.second);
+          }
+      }
+
+  PieceMoveClass[pt] = move_class(pt);
+  init_components();
+}
+
+
 namespace {
 
+  // move_class() derives the move class of a piece type from its attack tables.
+  // Squares reachable by a slide but not by a leap tell the slide directions,
+  // and a slider is range limited if it misses part of the lines on an empty board.
+  // The lines are computed directly, so that pieces can be added before the
+  // magic tables are initialized.
+
+  MoveClass move_class(PieceType pt) {
+
+    Direction diagonals[5] = { NORTH_EAST, SOUTH_EAST, SOUTH_WEST, NORTH_WEST };
+    Direction orthogonals[5] = { NORTH, EAST, SOUTH, WEST };
+    int mc = LEAPER;
+    bool fullDiagonal = true, fullOrthogonal = true;
+
+    for (Color c = WHITE; c <= BLACK; ++c)
+        for (Square s = SQ_A1; s <= SQ_H8; ++s)
+        {
+            Bitboard pseudo = PseudoAttacks[c][pt][s];
+            Bitboard slides = pseudo & ~LeaperAttacks[c][pt][s];
+            Bitboard diagonal = sliding_attack(diagonals, s, 0);
+            Bitboard orthogonal = sliding_attack(orthogonals, s, 0);
+
+            if (slides & diagonal)
+                mc |= DIAGONAL_SLIDER;
+
+            if (slides & orthogonal)
+                mc |= ORTHOGONAL_SLIDER;
+
+            fullDiagonal &= (pseudo & diagonal) == diagonal;
+            fullOrthogonal &= (pseudo & orthogonal) == orthogonal;
+        }
+
+    if (   ((mc & DIAGONAL_SLIDER) && !fullDiagonal)
+        || ((mc & ORTHOGONAL_SLIDER) && !fullOrthogonal))
+        mc |= RANGE_LIMITED;
+
+    return MoveClass(mc);
+  }
+
+
+  // Atoms are the smallest move sets which are mirror and color symmetric: the
+  // leaps (dx, dy) with 0 <= dx, dy <= 3 in all four sign combinations, indexed
+  // by 4 * dx + dy, and the slides along diagonals, files or ranks with a range
+  // from 1 to 7.
+
+  constexpr int LEAP_ATOM_NB = 16;
+  constexpr int ATOM_NB = LEAP_ATOM_NB + 3 * 7;
+
+  Bitboard AtomBB[ATOM_NB][SQUARE_NB];
+
+  ComponentKind atom_kind(int atom) {
+    return atom < LEAP_ATOM_NB ? LEAP_COMPONENT
+          : atom < LEAP_ATOM_NB + 7 ? DIAGONAL_COMPONENT : ORTHOGONAL_COMPONENT;
+  }
+
+  Bitboard atom_attacks(int atom, Square s) {
+
+    if (atom < LEAP_ATOM_NB)
+    {
+        Bitboard b = 0;
+        for (int dx : { -atom / 4, atom / 4 })
+            for (int dy : { -atom % 4, atom % 4 })
+            {
+                int f = file_of(s) + dx, r = rank_of(s) + dy;
+                if (f >= FILE_A && f <= FILE_H && r >= RANK_1 && r <= RANK_8)
+                    b |= make_square(File(f), Rank(r));
+            }
+        return b;
+    }
+
+    Direction lines[3][5] = { { NORTH_EAST, SOUTH_EAST, SOUTH_WEST, NORTH_WEST },
+                              { NORTH, SOUTH }, { EAST, WEST } };
+    int line = (atom - LEAP_ATOM_NB) / 7, range = (atom - LEAP_ATOM_NB) % 7 + 1;
+
+    return sliding_attack(lines[line], s, 0, range);
+  }
+
+
+  // decompose() returns the atoms whose union gives the attack tables of the
+  // given piece type, or 0 if there are none. Leap atoms are read around d4,
+  // slide atoms take the longest range contained in the tables, and the result
+  // is checked against the tables of both colors on all squares.
+
+  uint64_t decompose(PieceType pt) {
+
+    uint64_t atoms = 0;
+
+    for (int a = 1; a < LEAP_ATOM_NB; ++a)
+        if (LeaperAttacks[WHITE][pt][SQ_D4] & AtomBB[a][SQ_D4])
+            atoms |= 1ULL << a;
+
+    for (int line = 0; line < 3; ++line)
+        for (int range = 7; range >= 1; --range)
+        {
+            int a = LEAP_ATOM_NB + 7 * line + range - 1;
+            bool contained = true, slides = false;
+
+            for (Square s = SQ_A1; s <= SQ_H8; ++s)
+            {
+                contained &= !(AtomBB[a][s] & ~PseudoAttacks[WHITE][pt][s]);
+                slides |= bool(AtomBB[a][s] & ~LeaperAttacks[WHITE][pt][s]);
+            }
+
+            if (contained && slides)
+            {
+                atoms |= 1ULL << a;
+                break;
+            }
+        }
+
+    for (Color c = WHITE; c <= BLACK; ++c)
+        for (Square s = SQ_A1; s <= SQ_H8; ++s)
+        {
+            Bitboard leaps = 0, pseudo = 0;
+
+            for (int a = 1; a < ATOM_NB; ++a)
+                if (atoms & (1ULL << a))
+                    (a < LEAP_ATOM_NB ? leaps : pseudo) |= AtomBB[a][s];
+
+            if (   leaps != LeaperAttacks[c][pt][s]
+                || (leaps | pseudo) != PseudoAttacks[c][pt][s])
+                return 0;
+        }
+
+    return atoms;
+  }
+
+
+  // init_components() groups the atoms of all piece types by the set of types
+  // using them, each group with the same kind of lookup being one component.
+
+  void init_components() {
+
+    uint64_t typesOf[ATOM_NB] = {}, componentTypes[COMPONENT_NB] = {};
+    PieceType* irregular = IrregularTypes;
+
+    for (int a = 1; a < ATOM_NB; ++a)
+        for (Square s = SQ_A1; s <= SQ_H8; ++s)
+            AtomBB[a][s] = atom_attacks(a, s);
+
+    for (PieceType pt = PAWN; pt < PIECE_TYPE_NB; ++pt)
+    {
+        Bitboard moves = 0;
+        for (Square s = SQ_A1; s <= SQ_H8; ++s)
+            moves |= PseudoAttacks[WHITE][pt][s];
+
+        if (!moves)
+            continue;
+
+        uint64_t atoms = decompose(pt);
+
+        if (!atoms)
+            *irregular++ = pt;
+
+        for (int a = 1; a < ATOM_NB; ++a)
+            if (atoms & (1ULL << a))
+                typesOf[a] |= 1ULL << pt;
+    }
+    *irregular = NO_PIECE_TYPE;
+
+    std::fill(std::begin(PieceComponents), std::end(PieceComponents), 0);
+    ComponentNb = 0;
+    ComponentGeneration++;
+
+    for (int a = 1; a < ATOM_NB; ++a)
+    {
+        if (!typesOf[a])
+            continue;
+
+        int i = 0;
+        while (   i < ComponentNb
+               && (componentTypes[i] != typesOf[a] || ComponentKinds[i] != atom_kind(a)))
+            ++i;
+
+        if (i == ComponentNb)
+        {
+            assert(ComponentNb < COMPONENT_NB);
+            componentTypes[ComponentNb] = typesOf[a];
+            ComponentKinds[ComponentNb] = atom_kind(a);
+            std::fill(std::begin(ComponentAttacks[i]), std::end(ComponentAttacks[i]), 0);
+            ComponentNb++;
+        }
+
+        for (Square s = SQ_A1; s <= SQ_H8; ++s)
+            ComponentAttacks[i][s] |= AtomBB[a][s];
+
+        for (PieceType pt = PAWN; pt < PIECE_TYPE_NB; ++pt)
+            if (typesOf[a] & (1ULL << pt))
+                PieceComponents[pt] |= 1ULL << i;
+    }
+  }
+
+
   // init_magics() computes all rook and bishop attacks at startup. Magic
   // bitboards are used to look up attacks of sliding pieces. As a reference see
   // chessprogramming.wikispaces.com/Magic+Bitboards. In particular, here we
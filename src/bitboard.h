@@ -30,12 +30,15 @@ namespace Bitbases {
 
 void init();
 bool probe(Square wksq, Square wpsq, Square bksq, Color us);
+bool probe(PieceType pt, Square wksq, Square xsq, Square bksq, Color us, bool& win);
+bool probe(PieceType pt, Square wksq, Square xsq, Square bksq, Square psq, Color us, bool& win);
 
 }
 
 namespace Bitboards {
 
 void init();
+void init_piece(PieceType pt, const Betza::CompiledMoves& cm);
 const std::string pretty(Bitboard b);
 
 }
@@ -77,6 +80,68 @@ extern Bitboard PawnAttackSpan[COLOR_NB][SQUARE_NB];
 extern Bitboard PseudoAttacks[COLOR_NB][PIECE_TYPE_NB][SQUARE_NB];
 extern Bitboard LeaperAttacks[COLOR_NB][PIECE_TYPE_NB][SQUARE_NB];
 
+/// MoveClass tells which lookups the attacks of a piece type need. Leaps come
+/// from LeaperAttacks, diagonal and orthogonal slides from the bishop and rook
+/// magics, and range limited slides are masked with PseudoAttacks.
+enum MoveClass : int {
+  LEAPER            = 0,
+  DIAGONAL_SLIDER   = 1,
+  ORTHOGONAL_SLIDER = 2,
+  ALL_SLIDER        = DIAGONAL_SLIDER | ORTHOGONAL_SLIDER,
+  RANGE_LIMITED     = 4,
+  MOVE_CLASS_NB     = 8
+};
+
+/// Move classes of the built-in piece types, known at compile time
+constexpr MoveClass BuiltinMoveClass[KING + 1] = {
+  LEAPER,                                // NO_PIECE_TYPE
+  LEAPER,                                // Pawn
+  LEAPER,                                // Knight
+  DIAGONAL_SLIDER,                       // Bishop
+  ORTHOGONAL_SLIDER,                     // Rook
+  ALL_SLIDER,                            // Queen
+  LEAPER,                                // Cannon
+  MoveClass(DIAGONAL_SLIDER | RANGE_LIMITED), // Leopard
+  DIAGONAL_SLIDER,                       // Archbishop
+  ORTHOGONAL_SLIDER,                     // Chancellor
+  MoveClass(DIAGONAL_SLIDER | RANGE_LIMITED), // Spider
+  ALL_SLIDER,                            // Dragon
+  LEAPER,                                // Unicorn
+  LEAPER,                                // Hawk
+  LEAPER,                                // Elephant
+  MoveClass(DIAGONAL_SLIDER | RANGE_LIMITED), // Fortress
+  LEAPER                                 // King
+};
+
+extern MoveClass PieceMoveClass[PIECE_TYPE_NB];
+
+/// Movement components split the moves of the piece types in play into sets
+/// shared by the same piece types: e.g. the knight leaps of Knight, Leopard,
+/// Archbishop, Chancellor, Spider, Dragon, Unicorn and Fortress (in part) or the
+/// full diagonal slides of Bishop, Archbishop, Queen and Dragon. Position keeps
+/// one bitboard of pieces per component, so attackers_to() needs one lookup per
+/// component however many piece types are in play. Moves are mirror and color
+/// symmetric within a component; types that are not (e.g. pawns) are irregular
+/// and looked up type by type.
+enum ComponentKind : int {
+  LEAP_COMPONENT, DIAGONAL_COMPONENT, ORTHOGONAL_COMPONENT
+};
+
+constexpr int COMPONENT_NB = 36; // 15 leap sets and 21 slide sets at most
+
+extern Bitboard ComponentAttacks[COMPONENT_NB][SQUARE_NB];
+extern ComponentKind ComponentKinds[COMPONENT_NB];
+extern int ComponentNb;
+extern uint64_t PieceComponents[PIECE_TYPE_NB];
+extern PieceType IrregularTypes[PIECE_TYPE_NB];
+
+/// ComponentGeneration counts the renumberings of the components, one each time
+/// a piece type is added. A Position keeps its component bitboards, its list of
+/// piece types and its check info as of the generation it was set up in, so a
+/// Position that outlives a change of generation is stale and must be set up
+/// again with Position::set() before it is used.
+extern int ComponentGeneration;
+
 
 /// Magic holds all magic bitboards relevant data for a single square
 struct Magic {
@@ -273,18 +338,64 @@ inline Bitboard attacks_bb(Square s, Bitboard occupied) {
   return m.attacks[m.index(occupied)];
 }
 
+/// attacks_by_class() returns the attacks of a piece of type pt using only the
+/// lookups required by its move class MC.
+
+template<int MC>
+inline Bitboard attacks_by_class(Color c, PieceType pt, Square s, Bitboard occupied) {
+
+  Bitboard b = 0;
+
+  if (MC & DIAGONAL_SLIDER)
+      b |= attacks_bb<BISHOP>(s, occupied);
+
+  if (MC & ORTHOGONAL_SLIDER)
+      b |= attacks_bb<ROOK>(s, occupied);
+
+  if ((MC & RANGE_LIMITED) && (MC & ALL_SLIDER))
+      b &= PseudoAttacks[c][pt][s];
+
+  return LeaperAttacks[c][pt][s] | b;
+}
+
+/// attacks_bb() returns the attacks of any piece type, dispatching on its move
+/// class. The template version resolves the class of built-in types at compile time.
+
+template<PieceType Pt>
+inline Bitboard attacks_bb(Color c, Square s, Bitboard occupied) {
+
+  static_assert(Pt <= KING, "Move class of custom pieces is only known at runtime");
+  return attacks_by_class<BuiltinMoveClass[Pt]>(c, Pt, s, occupied);
+}
+
 inline Bitboard attacks_bb(Color c, PieceType pt, Square s, Bitboard occupied) {
-  return LeaperAttacks[c][pt][s] | (PseudoAttacks[c][pt][s] & (attacks_bb<BISHOP>(s, occupied) | attacks_bb<ROOK>(s, occupied)));
+
+  MoveClass mc = PieceMoveClass[pt];
+  Bitboard b = 0;
+
+  if (mc & DIAGONAL_SLIDER)
+      b |= attacks_bb<BISHOP>(s, occupied);
+
+  if (mc & ORTHOGONAL_SLIDER)
+      b |= attacks_bb<ROOK>(s, occupied);
+
+  if (mc & RANGE_LIMITED)
+      b &= PseudoAttacks[c][pt][s];
+
+  return LeaperAttacks[c][pt][s] | b;
 }
 
-/// attacks_from_betza() uses dynamic Betza notation for piece movement
+/// line_attacks_bb() returns the attacks of a piece type given the bishop and
+/// rook attacks from its square. Loops over piece types on the same square use
+/// it to pay for the two magic lookups only once.
+
+inline Bitboard line_attacks_bb(Color c, PieceType pt, Square s, Bitboard lineAttacks) {
+  return LeaperAttacks[c][pt][s] | (PseudoAttacks[c][pt][s] & lineAttacks);
+}
+
+/// attacks_from_betza() returns the attacks of a piece defined in Betza notation.
+/// Such pieces are compiled into the native tables when they are registered.
 inline Bitboard attacks_from_betza(Color c, PieceType pt, Square s, Bitboard occupied) {
-  // Try to get piece from Betza manager first
-  Betza::BetzaPiece* piece = Betza::betzaManager.getPiece(pt);
-  if (piece) {
-    return Betza::betzaManager.generateAttacks(c, *piece, s, occupied);
-  }
-  // Fallback to standard attacks_bb
   return attacks_bb(c, pt, s, occupied);
 }
 
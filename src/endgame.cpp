@@ -114,6 +114,7 @@ Endgames::Endgames() {
 /// king and plenty of material vs a lone king. It simply gives the
 /// attacking side a bonus for driving the defending king towards the edge
 /// of the board, and for keeping the distance between the two kings small.
+/// With a single fairy piece, a bitbase tells whether it can force mate.
 template<>
 Value Endgame<KXK>::operator()(const Position& pos) const {
 
@@ -132,7 +133,24 @@ Value Endgame<KXK>::operator()(const Position& pos) const {
                 + PushToEdges[loserKSq]
                 + PushClose[distance(winnerKSq, loserKSq)];
 
-  if (   pos.count<QUEEN>(strongSide)
+  // A single fairy piece may or may not force mate, the KXK bitbases know
+  // once they are built in the background. Until then it gets no bonus.
+  Bitboard x = pos.pieces(strongSide) ^ pos.pieces(strongSide, KING);
+  PieceType pt = x ? type_of(pos.piece_on(lsb(x))) : NO_PIECE_TYPE;
+  Color us = strongSide == pos.side_to_move() ? WHITE : BLACK;
+  bool win;
+
+  if (   !more_than_one(x) && pt > QUEEN && pt < KING && !pos.gates()
+      && Bitbases::probe(pt, relative_square(strongSide, winnerKSq), relative_square(strongSide, lsb(x)),
+                             relative_square(strongSide, loserKSq), us, win))
+  {
+      if (!win)
+          return VALUE_DRAW;
+
+      result = std::min(result + VALUE_KNOWN_WIN, VALUE_MATE_IN_MAX_PLY - 1);
+  }
+
+  else if (   pos.count<QUEEN>(strongSide)
       || pos.count<ROOK>(strongSide)
       ||(pos.count<BISHOP>(strongSide) && pos.count<KNIGHT>(strongSide))
       || (   (pos.pieces(strongSide, BISHOP) & ~DarkSquares)
@@ -293,6 +311,36 @@ Value Endgame<KQKP>::operator()(const Position& pos) const {
 }
 
 
+/// KX vs KP, with X a fairy piece. The evaluation is like KQ vs KP until the
+/// KXKP bitbase for X, which is built in the background on first use, is
+/// ready. Then the position is a known win or a draw.
+template<>
+Value Endgame<KXKP>::operator()(const Position& pos) const {
+
+  assert(verify_material(pos, weakSide, VALUE_ZERO, 1));
+  assert(!more_than_one(pos.pieces(strongSide) ^ pos.pieces(strongSide, KING)));
+
+  Square winnerKSq = pos.square<KING>(strongSide);
+  Square loserKSq = pos.square<KING>(weakSide);
+  Square pawnSq = pos.square<PAWN>(weakSide);
+  Square xsq = lsb(pos.pieces(strongSide) ^ pos.pieces(strongSide, KING));
+  PieceType pt = type_of(pos.piece_on(xsq));
+
+  Value result =  PieceValue[EG][pos.piece_on(xsq)] - PawnValueEg
+                + PushClose[distance(winnerKSq, loserKSq)];
+
+  Color us = strongSide == pos.side_to_move() ? WHITE : BLACK;
+  bool win;
+
+  if (   !pos.gates()
+      && Bitbases::probe(pt, relative_square(strongSide, winnerKSq), relative_square(strongSide, xsq),
+                             relative_square(strongSide, loserKSq), relative_square(strongSide, pawnSq), us, win))
+      result = win ? std::min(result + VALUE_KNOWN_WIN, VALUE_MATE_IN_MAX_PLY - 1) : VALUE_DRAW;
+
+  return strongSide == pos.side_to_move() ? result : -result;
+}
+
+
 /// KQ vs KR.  This is almost identical to KX vs K:  We give the attacking
 /// king a bonus for having the kings close together, and for forcing the
 /// defending king towards the edge. If we also take care to avoid null move for
@@ -45,6 +45,7 @@ enum EndgameCode {
   KRKN,  // KR vs KN
   KQKP,  // KQ vs KP
   KQKR,  // KQ vs KR
+  KXKP,  // KX vs KP, X being a fairy piece
 
   SCALING_FUNCTIONS,
   KBPsK,   // KB and pawns vs K
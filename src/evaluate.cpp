@@ -262,6 +262,7 @@ namespace {
   private:
     template<Color Us> void initialize();
     template<Color Us, PieceType Pt> Score pieces();
+    Score fairy_pieces();
     template<Color Us> Score king() const;
     template<Color Us> Score threats() const;
     template<Color Us> Score passed() const;
@@ -476,6 +477,45 @@ namespace {
   }
 
 
+  // Evaluation::fairy_pieces() scores the fairy pieces of both colors. A game
+  // uses only a few fairy types, so the pieces() instances of the types in play
+  // are called through a table instead of calling all of them.
+  template<Tracing T>
+  Score Evaluation<T>::fairy_pieces() {
+
+    typedef Score (Evaluation::*PiecesFn)();
+
+    static const PiecesFn Fairy[][COLOR_NB] = {
+      { &Evaluation::template pieces<WHITE, CANNON    >, &Evaluation::template pieces<BLACK, CANNON    > },
+      { &Evaluation::template pieces<WHITE, LEOPARD   >, &Evaluation::template pieces<BLACK, LEOPARD   > },
+      { &Evaluation::template pieces<WHITE, ARCHBISHOP>, &Evaluation::template pieces<BLACK, ARCHBISHOP> },
+      { &Evaluation::template pieces<WHITE, CHANCELLOR>, &Evaluation::template pieces<BLACK, CHANCELLOR> },
+      { &Evaluation::template pieces<WHITE, SPIDER    >, &Evaluation::template pieces<BLACK, SPIDER    > },
+      { &Evaluation::template pieces<WHITE, DRAGON    >, &Evaluation::template pieces<BLACK, DRAGON    > },
+      { &Evaluation::template pieces<WHITE, UNICORN   >, &Evaluation::template pieces<BLACK, UNICORN   > },
+      { &Evaluation::template pieces<WHITE, HAWK      >, &Evaluation::template pieces<BLACK, HAWK      > },
+      { &Evaluation::template pieces<WHITE, ELEPHANT  >, &Evaluation::template pieces<BLACK, ELEPHANT  > },
+      { &Evaluation::template pieces<WHITE, FORTRESS  >, &Evaluation::template pieces<BLACK, FORTRESS  > }
+    };
+
+    Score score = SCORE_ZERO;
+
+    // Gating pieces still waiting on their gates have nothing to score, and
+    // the attackedBy[] maps of the fairy types are not read elsewhere.
+    for (const PieceType* pt = pos.piece_types(); *pt; ++pt)
+        if (*pt >= CANNON && *pt < KING)
+        {
+            if (pos.pieces(WHITE, *pt))
+                score += (this->*Fairy[*pt - CANNON][WHITE])();
+
+            if (pos.pieces(BLACK, *pt))
+                score -= (this->*Fairy[*pt - CANNON][BLACK])();
+        }
+
+    return score;
+  }
+
+
   // Evaluation::king() assigns bonuses and penalties to a king of a given color
   template<Tracing T> template<Color Us>
   Score Evaluation<T>::king() const {
@@ -927,16 +967,7 @@ namespace {
             + pieces<WHITE, BISHOP     >() - pieces<BLACK, BISHOP     >()
             + pieces<WHITE, ROOK       >() - pieces<BLACK, ROOK       >()
             + pieces<WHITE, QUEEN      >() - pieces<BLACK, QUEEN      >()
-            + pieces<WHITE, CANNON     >() - pieces<BLACK, CANNON     >()
-            + pieces<WHITE, LEOPARD    >() - pieces<BLACK, LEOPARD    >()
-            + pieces<WHITE, ARCHBISHOP >() - pieces<BLACK, ARCHBISHOP >()
-            + pieces<WHITE, CHANCELLOR >() - pieces<BLACK, CHANCELLOR >()
-            + pieces<WHITE, SPIDER     >() - pieces<BLACK, SPIDER     >()
-            + pieces<WHITE, DRAGON     >() - pieces<BLACK, DRAGON     >()
-            + pieces<WHITE, UNICORN    >() - pieces<BLACK, UNICORN    >()
-            + pieces<WHITE, HAWK       >() - pieces<BLACK, HAWK       >()
-            + pieces<WHITE, ELEPHANT   >() - pieces<BLACK, ELEPHANT   >()
-            + pieces<WHITE, FORTRESS   >() - pieces<BLACK, FORTRESS   >();
+            + fairy_pieces();
 
     score += mobility[WHITE] - mobility[BLACK];
 
@@ -979,6 +1010,57 @@ Value Eval::evaluate(const Position& pos) {
 }
 
 
+/// Eval::Cache::resize() sets the size of the eval cache, rounded down to a
+/// power of two number of entries, and clears it.
+
+void Eval::Cache::resize(size_t mbSize) {
+
+  size_t count = mbSize * 1024 * 1024 / sizeof(Entry);
+
+  table.assign(count ? size_t(1) << msb(count) : 0, Entry());
+  hits = probes = 0;
+}
+
+
+/// Eval::Cache::clear() empties the eval cache and resets its counters
+
+void Eval::Cache::clear() {
+
+  std::fill(table.begin(), table.end(), Entry());
+  hits = probes = 0;
+}
+
+
+/// Eval::Cache::evaluate() returns the static evaluation of the position from
+/// the cache, or calls evaluate() and stores the result on a miss.
+
+Value Eval::Cache::evaluate(const Position& pos) {
+
+  if (table.empty())
+      return Eval::evaluate(pos);
+
+  Entry* e = &table[pos.key() & (table.size() - 1)];
+  uint32_t key32 = uint32_t(pos.key() >> 32);
+  int16_t contempt = int16_t(mg_value(pos.this_thread()->contempt));
+
+  probes++;
+
+  if (e->key32 == key32 && e->contempt == contempt)
+  {
+      hits++;
+      return Value(e->value);
+  }
+
+  Value v = Eval::evaluate(pos);
+
+  e->key32 = key32;
+  e->value = int16_t(v);
+  e->contempt = contempt;
+
+  return v;
+}
+
+
 /// trace() is like evaluate(), but instead of returning a value, it returns
 /// a string (suitable for outputting to stdout) that contains the detailed
 /// descriptions and values of each evaluation term. Useful for debugging.
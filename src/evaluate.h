@@ -23,7 +23,9 @@
 
 #include <atomic>
 #include <string>
+#include <vector>
 
+#include "misc.h"
 #include "types.h"
 
 class Position;
@@ -35,6 +37,33 @@ constexpr Value Tempo = Value(20); // Must be visible to search
 std::string trace(const Position& pos);
 
 Value evaluate(const Position& pos);
-}
+
+/// Eval::Cache is a per-thread hash table of static evaluations, probed by the
+/// search before calling evaluate() when the transposition table has no eval
+/// for the position. Entries are tagged with the contempt they were computed
+/// with, as it changes between iterations. Its size in MB is set by the
+/// "Eval Cache" UCI option, 0 (the default) disables it.
+
+class Cache {
+
+  struct Entry {
+    uint32_t key32;
+    int16_t value;
+    int16_t contempt;
+  };
+
+public:
+  void resize(size_t mbSize);
+  void clear();
+  Value evaluate(const Position& pos);
+  void prefetch(Key key) { if (!table.empty()) ::prefetch(&table[key & (table.size() - 1)]); }
+
+  uint64_t hits, probes;
+
+private:
+  std::vector<Entry> table;
+};
+
+} // namespace Eval
 
 #endif // #ifndef EVALUATE_H_INCLUDED
@@ -0,0 +1,1036 @@
+/*
+  Stockfish, a UCI chess playing engine derived from Glaurung 2.1
+  Copyright (C) 2004-2008 Tord Romstad (Glaurung author)
+  Copyright (C) 2008-2015 Marco Costalba, Joona Kiiski, Tord Romstad
+  Copyright (C) 2015-2018 Marco Costalba, Joona Kiiski, Gary Linscott, Tord Romstad
+
+  Stockfish is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Stockfish is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstring>   // For std::memcmp and std::strncpy
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <set>
+#include <sstream>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "bitboard.h"
+#include "fairytb.h"
+#include "misc.h"
+#include "movegen.h"
+#include "position.h"
+#include "uci.h"
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#else
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#endif
+
+using namespace Tablebases;
+
+int FairyTablebases::MaxCardinality;
+
+namespace {
+
+  constexpr int TBPIECES = FairyTablebases::TBPIECES;
+
+  // A table file is a FileHeader, the offsets of the blocks in the data and
+  // the data. A block holds the symbols of BlockSize consecutive positions as
+  // (run length, symbol) byte pairs. Values are stored in native byte order.
+  constexpr uint32_t Version = 1;
+  constexpr uint64_t BlockSize = 4096;
+
+  enum TBType { WDL, DTZ };
+
+  const std::string Extensions[] = { ".mtbw", ".mtbz" };
+  const char* Magics[] = { "MUSKTBW", "MUSKTBZ" };
+
+  struct FileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t blockSize;
+    uint64_t size;
+    uint64_t blockCount;
+    uint8_t mirrorFiles, mirrorRanks;
+    char code[14];
+    char padding[16];
+  };
+
+  static_assert(sizeof(FileHeader) == 64, "FileHeader size incorrect");
+
+  // is_tb_piece() tells whether a piece type may be in a table besides the
+  // kings. Pawns are left out because what they promote to depends on the
+  // pieces each side gated.
+  bool is_tb_piece(PieceType pt) { return pt >= KNIGHT && pt < KING; }
+
+  PieceType piece_type(char c) {
+    size_t idx = PieceToChar.find(c);
+    return idx == std::string::npos || idx >= KING + 1 ? NO_PIECE_TYPE : PieceType(idx);
+  }
+
+  // symmetric() tells whether the moves of a piece type map to each other when
+  // the squares are transformed with s ^ t: t = 7 mirrors the files, t = 56
+  // the ranks. With 'swapColors' the moves of one color are compared with the
+  // moves of the other.
+  bool symmetric(PieceType pt, int t, bool swapColors) {
+
+    for (Color c = WHITE; c <= BLACK; ++c)
+        for (Square s = SQ_A1; s <= SQ_H8; ++s)
+        {
+            Color c2 = swapColors ? ~c : c;
+            Square s2 = Square(s ^ t);
+            Bitboard leaper = 0, pseudo = 0;
+
+            for (Bitboard b = LeaperAttacks[c][pt][s]; b; )
+                leaper |= Square(pop_lsb(&b) ^ t);
+
+            for (Bitboard b = PseudoAttacks[c][pt][s]; b; )
+                pseudo |= Square(pop_lsb(&b) ^ t);
+
+            if (leaper != LeaperAttacks[c2][pt][s2] || pseudo != PseudoAttacks[c2][pt][s2])
+                return false;
+        }
+
+    return true;
+  }
+
+  // reversible() tells whether a piece type can go back to the square it came
+  // from, so that the moves to a square are found from its attacks
+  bool reversible(PieceType pt) {
+
+    for (Color c = WHITE; c <= BLACK; ++c)
+        for (Square s1 = SQ_A1; s1 <= SQ_H8; ++s1)
+            for (Square s2 = SQ_A1; s2 <= SQ_H8; ++s2)
+                if (   bool(LeaperAttacks[c][pt][s1] & s2) != bool(LeaperAttacks[c][pt][s2] & s1)
+                    || bool(PseudoAttacks[c][pt][s1] & s2) != bool(PseudoAttacks[c][pt][s2] & s1))
+                    return false;
+
+    return true;
+  }
+
+  // stronger() orders the sides of an endgame code: more pieces first, then
+  // the higher piece types. The pieces of a side are sorted by descending type.
+  bool stronger(const std::string& a, const std::string& b) {
+
+    if (a.length() != b.length())
+        return a.length() > b.length();
+
+    for (size_t i = 0; i < a.length(); ++i)
+        if (piece_type(a[i]) != piece_type(b[i]))
+            return piece_type(a[i]) > piece_type(b[i]);
+
+    return false;
+  }
+
+  // canonical() normalizes an endgame code like "KRvKA" to "KAvKR". It returns
+  // an empty string if no table can have the code.
+  std::string canonical(const std::string& code) {
+
+    size_t v = code.find('v');
+
+    if (v == std::string::npos || code.length() > TBPIECES + 1)
+        return std::string();
+
+    std::string sides[] = { code.substr(0, v), code.substr(v + 1) };
+
+    for (std::string& side : sides)
+    {
+        if (side.empty() || side[0] != 'K')
+            return std::string();
+
+        for (size_t i = 1; i < side.length(); ++i)
+            if (!is_tb_piece(piece_type(side[i])))
+                return std::string();
+
+        std::sort(side.begin() + 1, side.end(), [](char a, char b) { return piece_type(a) > piece_type(b); });
+    }
+
+    if (stronger(sides[1], sides[0]))
+        std::swap(sides[0], sides[1]);
+
+    return sides[0] + "v" + sides[1];
+  }
+
+  // A Layout maps the positions of an endgame to table indices. The pieces are
+  // in slots: the white king, the black king, then the other pieces in the order
+  // of the code. If the moves of all of them allow it, the white king is kept
+  // on the queen side and on the lower half of the board by mirroring the board.
+  // The side to move is the most significant part, so that the symbols of
+  // neighbouring indices are alike:
+  //
+  // index = white king + kingSquares * (black king + 64 * (... + 64 * stm))
+  struct Layout {
+    explicit Layout(const std::string& code);
+    uint64_t index(const Square* squares, Color stm) const;
+    void decode(uint64_t idx, Square* squares, Color& stm) const;
+
+    std::string code;
+    int count;
+    Color color[TBPIECES];
+    PieceType type[TBPIECES];
+    bool mirrorFiles, mirrorRanks;
+    uint64_t kingSquares, size;
+  };
+
+  Layout::Layout(const std::string& c) : code(c), count(2) {
+
+    assert(canonical(c) == c);
+
+    color[0] = WHITE, type[0] = KING;
+    color[1] = BLACK, type[1] = KING;
+    mirrorFiles = mirrorRanks = true;
+
+    for (Color side = WHITE; side <= BLACK; ++side)
+        for (char ch : code.substr(side == WHITE ? 1 : code.find('v') + 2))
+        {
+            if (ch == 'v')
+                break;
+
+            color[count] = side, type[count++] = piece_type(ch);
+        }
+
+    for (int i = 0; i < count; ++i)
+    {
+        mirrorFiles &= symmetric(type[i], 7, false);
+        mirrorRanks &= symmetric(type[i], 56, false);
+    }
+
+    kingSquares = (mirrorFiles ? 4 : 8) * (mirrorRanks ? 4 : 8);
+    size = COLOR_NB * kingSquares;
+
+    for (int i = 1; i < count; ++i)
+        size *= 64;
+  }
+
+  uint64_t Layout::index(const Square* squares, Color stm) const {
+
+    int t = 0;
+
+    if (mirrorFiles && file_of(squares[0]) > FILE_D)
+        t ^= 7;
+
+    if (mirrorRanks && rank_of(squares[0]) > RANK_4)
+        t ^= 56;
+
+    uint64_t idx = stm;
+
+    for (int i = count - 1; i > 0; --i)
+        idx = idx * 64 + (squares[i] ^ t);
+
+    Square ksq = Square(squares[0] ^ t);
+    return idx * kingSquares + (mirrorFiles ? 4 * rank_of(ksq) + file_of(ksq) : int(ksq));
+  }
+
+  void Layout::decode(uint64_t idx, Square* squares, Color& stm) const {
+
+    int k = int(idx % kingSquares);
+    squares[0] = mirrorFiles ? make_square(File(k % 4), Rank(k / 4)) : Square(k);
+    idx /= kingSquares;
+
+    for (int i = 1; i < count; ++i, idx /= 64)
+        squares[i] = Square(idx % 64);
+
+    stm = Color(idx);
+  }
+
+
+  // Generator builds the table of an endgame by retrograde analysis. Values
+  // are stored per position as 16 bit numbers: WIN(n) and LOSS(n) mean the side
+  // to move wins or loses with n plies to the mate or to the next capture when
+  // both sides play best.
+  //
+  // The positions are first classified by initial(): invalid positions, mates,
+  // stalemates, and the positions decided by captures into a smaller table.
+  // Then each pass n looks at the positions with a distance of n and at the
+  // positions one move before them. A position is a WIN(n + 1) if it has a move
+  // to a LOSS(n), and a LOSS(n + 1) if all its moves go to positions already won
+  // by the opponent. The passes are split among threads, which may see the
+  // results of the pass being done: those have distance n + 1 and are skipped
+  // by the other checks of the pass. The positions left unknown are draws.
+  enum : uint16_t { UNKNOWN, INVALID, DRAW };
+
+  uint16_t win(int n)  { return uint16_t(4 + 2 * n); }
+  uint16_t loss(int n) { return uint16_t(5 + 2 * n); }
+  bool is_win(uint16_t v)  { return v >= 4 && !(v & 1); }
+  bool is_loss(uint16_t v) { return v >= 4 &&  (v & 1); }
+  int plies(uint16_t v) { return (v - 4) / 2; }
+
+  class Generator;
+  typedef std::map<std::string, std::unique_ptr<Generator>> Generators;
+
+  class Generator {
+
+    struct Pos {
+      Square sq[TBPIECES];
+      Color stm;
+      Bitboard byColor[COLOR_NB];
+    };
+
+    // The smaller table reached by capturing a piece. The slots of that table
+    // are filled from the slots of this one.
+    struct Capture {
+      const Generator* table;
+      bool swapColors;
+      int slot[TBPIECES];
+    };
+
+  public:
+    Generator(const std::string& code, Generators& tables, unsigned threads);
+    uint16_t value(uint64_t idx) const { return db[idx].load(std::memory_order_relaxed); }
+    void build();
+    void write(const std::string& dir) const;
+
+    const Layout layout;
+
+  private:
+    Pos decode(uint64_t idx) const;
+    int piece_on(const Pos& p, Square s) const;
+    bool attacked(const Pos& p, Square s, Color by, Bitboard occupied) const;
+    uint16_t capture_value(const Pos& p, int from, Square to, int captured) const;
+    uint16_t initial(uint64_t idx) const;
+    bool all_moves_win(const Pos& p, int n) const;
+    uint64_t propagate(uint64_t idx, int n);
+    template<typename F> uint64_t parallel_for(F fn) const;
+
+    Capture captures[TBPIECES];
+    bool isReversible[TBPIECES];
+    const unsigned threadCount;
+    std::vector<std::atomic<uint16_t>> db;
+  };
+
+  // get_table() returns the generated table of an endgame, building it and the
+  // smaller tables it needs first
+  const Generator* get_table(const std::string& code, Generators& tables, unsigned threads) {
+
+    auto it = tables.find(code);
+    if (it != tables.end())
+        return it->second.get();
+
+    Generator* g = new Generator(code, tables, threads);
+    tables[code].reset(g);
+    g->build();
+    return g;
+  }
+
+  Generator::Generator(const std::string& code, Generators& tables, unsigned threads)
+    : layout(code), threadCount(threads) {
+
+    for (int j = 0; j < layout.count; ++j)
+    {
+        isReversible[j] = reversible(layout.type[j]);
+
+        if (layout.type[j] == KING)
+            continue;
+
+        // The endgame after piece j is captured
+        std::string sides[COLOR_NB];
+        for (int i = 0; i < layout.count; ++i)
+            if (i != j)
+                sides[layout.color[i]] += PieceToChar[layout.type[i]];
+
+        Capture& c = captures[j];
+        std::string sub = canonical(sides[WHITE] + "v" + sides[BLACK]);
+        c.table = get_table(sub, tables, threads);
+        c.swapColors = sub != sides[WHITE] + "v" + sides[BLACK];
+
+        // Fill each slot of that table with a remaining piece of its type
+        bool used[TBPIECES] = {};
+        for (int s = 0; s < c.table->layout.count; ++s)
+            for (int i = 0; i < layout.count; ++i)
+                if (   i != j && !used[i]
+                    && layout.type[i] == c.table->layout.type[s]
+                    && layout.color[i] == (c.swapColors ? ~c.table->layout.color[s] : c.table->layout.color[s]))
+                {
+                    c.slot[s] = i, used[i] = true;
+                    break;
+                }
+    }
+
+    db = std::vector<std::atomic<uint16_t>>(layout.size);
+  }
+
+  Generator::Pos Generator::decode(uint64_t idx) const {
+
+    Pos p;
+    layout.decode(idx, p.sq, p.stm);
+    p.byColor[WHITE] = p.byColor[BLACK] = 0;
+
+    for (int i = 0; i < layout.count; ++i)
+        p.byColor[layout.color[i]] |= p.sq[i];
+
+    return p;
+  }
+
+  int Generator::piece_on(const Pos& p, Square s) const {
+
+    for (int i = 0; i < layout.count; ++i)
+        if (p.sq[i] == s)
+            return i;
+
+    return -1;
+  }
+
+  bool Generator::attacked(const Pos& p, Square s, Color by, Bitboard occupied) const {
+
+    for (int i = 0; i < layout.count; ++i)
+        if (   layout.color[i] == by
+            && (attacks_bb(by, layout.type[i], p.sq[i], occupied) & s))
+            return true;
+
+    return false;
+  }
+
+  uint16_t Generator::capture_value(const Pos& p, int from, Square to, int captured) const {
+
+    const Capture& c = captures[captured];
+    const Layout& sub = c.table->layout;
+    Square sq[TBPIECES];
+
+    for (int s = 0; s < sub.count; ++s)
+    {
+        sq[s] = c.slot[s] == from ? to : p.sq[c.slot[s]];
+        if (c.swapColors)
+            sq[s] = ~sq[s];
+    }
+
+    return c.table->value(sub.index(sq, c.swapColors ? p.stm : ~p.stm));
+  }
+
+  uint16_t Generator::initial(uint64_t idx) const {
+
+    Pos p = decode(idx);
+    Color us = p.stm;
+    Bitboard occupied = p.byColor[WHITE] | p.byColor[BLACK];
+
+    // Two pieces on the same square, or the side not to move in check
+    if (   popcount(occupied) < layout.count
+        || attacked(p, p.sq[~us], us, occupied))
+        return INVALID;
+
+    // The passes only reach positions with a legal move that is not a capture,
+    // so the positions where all legal moves are captures into lost positions
+    // are classified here.
+    bool hasMove = false, allLose = true;
+
+    for (int i = 0; i < layout.count; ++i)
+    {
+        if (layout.color[i] != us)
+            continue;
+
+        Bitboard b = attacks_bb(us, layout.type[i], p.sq[i], occupied) & ~p.byColor[us];
+
+        while (b)
+        {
+            Square to = pop_lsb(&b);
+
+            if (p.byColor[~us] & to)
+            {
+                uint16_t v = capture_value(p, i, to, piece_on(p, to));
+
+                if (is_loss(v))
+                    return win(1);
+
+                if (v != INVALID)
+                    hasMove = true, allLose &= is_win(v);
+            }
+            else if (allLose && !attacked(p, i == us ? to : p.sq[us], ~us, occupied ^ p.sq[i] ^ to))
+                hasMove = true, allLose = false;
+        }
+    }
+
+    if (!hasMove)
+        return attacked(p, p.sq[us], ~us, occupied) ? loss(0) : uint16_t(DRAW);
+
+    return allLose ? loss(1) : uint16_t(UNKNOWN);
+  }
+
+  bool Generator::all_moves_win(const Pos& p, int n) const {
+
+    Color us = p.stm;
+    Bitboard occupied = p.byColor[WHITE] | p.byColor[BLACK];
+    Square sq[TBPIECES];
+    std::copy(p.sq, p.sq + layout.count, sq);
+
+    for (int i = 0; i < layout.count; ++i)
+    {
+        if (layout.color[i] != us)
+            continue;
+
+        Bitboard b = attacks_bb(us, layout.type[i], p.sq[i], occupied) & ~p.byColor[us];
+
+        while (b)
+        {
+            Square to = pop_lsb(&b);
+            bool capture = p.byColor[~us] & to;
+            uint16_t v;
+
+            if (capture)
+                v = capture_value(p, i, to, piece_on(p, to));
+            else
+            {
+                sq[i] = to;
+                v = value(layout.index(sq, ~us));
+                sq[i] = p.sq[i];
+            }
+
+            if (v != INVALID && (!is_win(v) || (!capture && plies(v) > n)))
+                return false;
+        }
+    }
+
+    return true;
+  }
+
+  uint64_t Generator::propagate(uint64_t idx, int n) {
+
+    uint16_t v = value(idx);
+
+    if (v < 4 || plies(v) != n)
+        return 0;
+
+    Pos p = decode(idx);
+    Color them = ~p.stm; // The side that moved to this position
+    Bitboard occupied = p.byColor[WHITE] | p.byColor[BLACK];
+
+    for (int i = 0; i < layout.count; ++i)
+    {
+        if (layout.color[i] != them)
+            continue;
+
+        Square to = p.sq[i];
+        Bitboard b = (isReversible[i] ? attacks_bb(them, layout.type[i], to, occupied) : AllSquares) & ~occupied;
+
+        while (b)
+        {
+            Square from = pop_lsb(&b);
+
+            if (!(attacks_bb(them, layout.type[i], from, occupied) & to))
+                continue;
+
+            Pos q = p;
+            q.sq[i] = from;
+            q.stm = them;
+            q.byColor[them] ^= SquareBB[from] | to;
+
+            uint64_t qidx = layout.index(q.sq, them);
+            uint16_t expected = UNKNOWN;
+
+            if (value(qidx) != UNKNOWN)
+                continue;
+
+            if (is_loss(v))
+                db[qidx].compare_exchange_strong(expected, win(n + 1));
+
+            else if (all_moves_win(q, n))
+                db[qidx].compare_exchange_strong(expected, loss(n + 1));
+        }
+    }
+
+    return 1;
+  }
+
+  template<typename F>
+  uint64_t Generator::parallel_for(F fn) const {
+
+    // Threads take chunks of positions until all are done
+    constexpr uint64_t Chunk = 1 << 16;
+    std::atomic<uint64_t> next(0), total(0);
+
+    auto worker = [&]() {
+        uint64_t sum = 0, begin;
+
+        while ((begin = next.fetch_add(Chunk)) < layout.size)
+            for (uint64_t idx = begin; idx < std::min(begin + Chunk, layout.size); ++idx)
+                sum += fn(idx);
+
+        total += sum;
+    };
+
+    std::vector<std::thread> threads;
+
+    for (unsigned i = 1; i < threadCount; ++i)
+        threads.emplace_back(worker);
+
+    worker();
+
+    for (std::thread& th : threads)
+        th.join();
+
+    return total;
+  }
+
+  void Generator::build() {
+
+    TimePoint start = now();
+
+    parallel_for([this](uint64_t idx) {
+        db[idx].store(initial(idx), std::memory_order_relaxed);
+        return uint64_t(0);
+    });
+
+    int n = 0;
+
+    while (parallel_for([this, n](uint64_t idx) { return propagate(idx, n); }) || n == 0)
+        ++n;
+
+    uint64_t draws = parallel_for([this](uint64_t idx) {
+        if (value(idx) != UNKNOWN)
+            return uint64_t(0);
+
+        db[idx].store(DRAW, std::memory_order_relaxed);
+        return uint64_t(1);
+    });
+
+    sync_cout << "info string Generated " << layout.code
+              << " positions " << layout.size
+              << " draws " << draws
+              << " longest " << n - 1 << " plies"
+              << " time " << now() - start << " ms" << sync_endl;
+  }
+
+  // write() stores the table in a WDL file and a DTZ file. The WDL symbols are
+  // WDLScore + 2, with a distance over 100 plies making a cursed win or blessed
+  // loss. The DTZ symbols are the distances, capped at 255. Positions that are
+  // never probed take the previous symbol, which makes longer runs: invalid
+  // positions in both files, and draws in the DTZ file.
+  void Generator::write(const std::string& dir) const {
+
+    for (TBType type : { WDL, DTZ })
+    {
+        std::vector<uint64_t> offsets;
+        std::vector<uint8_t> data;
+        uint8_t prev = WDLDraw + 2;
+
+        for (uint64_t begin = 0; begin < layout.size; begin += BlockSize)
+        {
+            offsets.push_back(data.size());
+
+            for (uint64_t idx = begin; idx < std::min(begin + BlockSize, layout.size); ++idx)
+            {
+                uint16_t v = value(idx);
+                uint8_t sym =  v == INVALID || (type == DTZ && v < 4) ? prev
+                             : type == DTZ ? uint8_t(std::min(plies(v), 255))
+                             : v == DRAW   ? uint8_t(WDLDraw + 2)
+                             : uint8_t((is_win(v) ? (plies(v) > 100 ? WDLCursedWin : WDLWin)
+                                                  : (plies(v) > 100 ? WDLBlessedLoss : WDLLoss)) + 2);
+
+                if (idx == begin || sym != data.back() || data[data.size() - 2] == 255)
+                    data.push_back(0), data.push_back(sym);
+
+                data[data.size() - 2]++;
+                prev = sym;
+            }
+        }
+
+        offsets.push_back(data.size());
+
+        FileHeader h = {};
+        std::strncpy(h.magic, Magics[type], sizeof(h.magic));
+        std::strncpy(h.code, layout.code.c_str(), sizeof(h.code) - 1);
+        h.version = Version;
+        h.blockSize = BlockSize;
+        h.size = layout.size;
+        h.blockCount = offsets.size() - 1;
+        h.mirrorFiles = layout.mirrorFiles;
+        h.mirrorRanks = layout.mirrorRanks;
+
+        std::string fname = dir + "/" + layout.code + Extensions[type];
+        std::ofstream file(fname, std::ios::binary);
+
+        file.write(reinterpret_cast<const char*>(&h), sizeof(h));
+        file.write(reinterpret_cast<const char*>(offsets.data()), offsets.size() * sizeof(uint64_t));
+        file.write(reinterpret_cast<const char*>(data.data()), data.size());
+
+        if (!file)
+            sync_cout << "info string Could not write " << fname << sync_endl;
+    }
+  }
+
+
+  // A ProbeTable holds the memory mapped files of an endgame. The DTZ file is
+  // optional.
+  struct ProbeTable {
+    explicit ProbeTable(const std::string& code) : layout(code) {}
+    ~ProbeTable();
+    bool map(TBType type, const std::string& fname);
+    void unmap(TBType type);
+    int symbol(TBType type, uint64_t idx) const;
+
+    Layout layout;
+    void* baseAddress[2] = {};
+    uint64_t mapping[2] = {};
+    const uint64_t* offsets[2] = {};
+    const uint8_t* data[2] = {};
+  };
+
+  std::deque<ProbeTable> Tables;
+  std::unordered_map<Key, std::pair<const ProbeTable*, bool>> TableByKey; // Table, colors swapped
+
+  ProbeTable::~ProbeTable() {
+
+    unmap(WDL);
+    unmap(DTZ);
+  }
+
+  void ProbeTable::unmap(TBType type) {
+
+    if (!baseAddress[type])
+        return;
+
+#ifndef _WIN32
+    munmap(baseAddress[type], mapping[type]);
+#else
+    UnmapViewOfFile(baseAddress[type]);
+    CloseHandle((HANDLE)mapping[type]);
+#endif
+    baseAddress[type] = nullptr;
+  }
+
+  bool ProbeTable::map(TBType type, const std::string& fname) {
+
+#ifndef _WIN32
+    struct stat statbuf;
+    int fd = ::open(fname.c_str(), O_RDONLY);
+
+    if (fd == -1)
+        return false;
+
+    fstat(fd, &statbuf);
+    mapping[type] = statbuf.st_size;
+    void* base = statbuf.st_size < (off_t)sizeof(FileHeader) ? MAP_FAILED
+               : mmap(nullptr, statbuf.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+
+    if (base == MAP_FAILED)
+        return false;
+#else
+    HANDLE fd = CreateFile(fname.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                           OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+
+    if (fd == INVALID_HANDLE_VALUE)
+        return false;
+
+    DWORD size_high;
+    DWORD size_low = GetFileSize(fd, &size_high);
+    HANDLE mmap = CreateFileMapping(fd, nullptr, PAGE_READONLY, size_high, size_low, nullptr);
+    CloseHandle(fd);
+
+    if (!mmap)
+        return false;
+
+    mapping[type] = (uint64_t)mmap;
+    void* base = MapViewOfFile(mmap, FILE_MAP_READ, 0, 0, 0);
+
+    if (!base)
+    {
+        CloseHandle(mmap);
+        return false;
+    }
+#endif
+    baseAddress[type] = base;
+
+    // The layout depends on the attack tables, so check that it did not change
+    const FileHeader* h = static_cast<const FileHeader*>(base);
+
+    if (   std::memcmp(h->magic, Magics[type], sizeof(h->magic))
+        || h->version != Version
+        || h->blockSize != BlockSize
+        || h->size != layout.size
+        || h->mirrorFiles != layout.mirrorFiles
+        || h->mirrorRanks != layout.mirrorRanks)
+    {
+        std::cerr << "Corrupted table in file " << fname << std::endl;
+        unmap(type);
+        return false;
+    }
+
+    offsets[type] = reinterpret_cast<const uint64_t*>(h + 1);
+    data[type] = reinterpret_cast<const uint8_t*>(offsets[type] + h->blockCount + 1);
+    return true;
+  }
+
+  int ProbeTable::symbol(TBType type, uint64_t idx) const {
+
+    const uint8_t* p = data[type] + offsets[type][idx / BlockSize];
+
+    for (idx %= BlockSize; idx >= *p; p += 2)
+        idx -= *p;
+
+    return p[1];
+  }
+
+  // add() maps the files of an endgame if they are found in one of the paths,
+  // separated like SyzygyPath
+  void add(const std::string& code, const std::string& paths) {
+
+#ifndef _WIN32
+    constexpr char SepChar = ':';
+#else
+    constexpr char SepChar = ';';
+#endif
+    std::stringstream ss(paths);
+    std::string path;
+    ProbeTable* t = nullptr;
+
+    while (std::getline(ss, path, SepChar))
+        for (TBType type : { WDL, DTZ })
+        {
+            std::string fname = path + "/" + code + Extensions[type];
+
+            if ((t && t->data[type]) || !std::ifstream(fname))
+                continue;
+
+            if (!t)
+            {
+                Tables.emplace_back(code);
+                t = &Tables.back();
+            }
+
+            t->map(type, fname);
+        }
+
+    if (!t || !t->data[WDL])
+    {
+        if (t)
+            Tables.pop_back();
+        return;
+    }
+
+    StateInfo st;
+    Position pos;
+    std::string pieces = code.substr(0, code.find('v')) + code.substr(code.find('v') + 1);
+
+    Key key  = pos.set(pieces, WHITE, &st).material_key();
+    Key key2 = pos.set(pieces, BLACK, &st).material_key();
+
+    // The keys are the same for symmetric endgames like KAvKA
+    TableByKey[key2] = std::make_pair(t, true);
+    TableByKey[key]  = std::make_pair(t, false);
+
+    FairyTablebases::MaxCardinality = std::max(t->layout.count, FairyTablebases::MaxCardinality);
+  }
+
+  // all_codes() returns the codes of all the endgames the tables can have
+  std::set<std::string> all_codes() {
+
+    std::vector<std::string> sides = { "" };
+
+    for (size_t i = 0; i < sides.size(); ++i)
+        if (int(sides[i].length()) < TBPIECES - 2)
+            for (PieceType pt = KNIGHT; pt < KING; ++pt)
+                if (sides[i].empty() || pt <= piece_type(sides[i].back()))
+                    sides.push_back(sides[i] + PieceToChar[pt]);
+
+    std::set<std::string> codes;
+
+    for (const std::string& w : sides)
+        for (const std::string& b : sides)
+            if (!w.empty() && w.length() + b.length() <= TBPIECES - 2)
+                codes.insert(canonical("K" + w + "vK" + b));
+
+    return codes;
+  }
+
+  // probe_table() finds the table of the position and its index in the table
+  const ProbeTable* probe_table(const Position& pos, uint64_t& idx) {
+
+    auto it = TableByKey.find(pos.material_key());
+
+    if (it == TableByKey.end())
+        return nullptr;
+
+    const ProbeTable* t = it->second.first;
+    bool swapColors = it->second.second;
+    Square sq[TBPIECES];
+    Bitboard used = 0;
+
+    assert(popcount(pos.pieces()) == t->layout.count);
+
+    for (int i = 0; i < t->layout.count; ++i)
+    {
+        Color c = swapColors ? ~t->layout.color[i] : t->layout.color[i];
+        Square s = lsb(pos.pieces(c, t->layout.type[i]) & ~used);
+        used |= s;
+        sq[i] = swapColors ? ~s : s;
+    }
+
+    idx = t->layout.index(sq, swapColors ? ~pos.side_to_move() : pos.side_to_move());
+    return t;
+  }
+
+} // namespace
+
+
+/// FairyTablebases::init() is called at startup and after every change to the
+/// "FairyTBPath" UCI option. It maps the tables found in the paths. Like
+/// Tablebases::init(), it is not thread safe.
+
+void FairyTablebases::init(const std::string& paths) {
+
+  TableByKey.clear();
+  Tables.clear();
+  MaxCardinality = 0;
+
+  if (paths.empty() || paths == "<empty>")
+      return;
+
+  for (const std::string& code : all_codes())
+      add(code, paths);
+
+  sync_cout << "info string Found " << Tables.size() << " fairy tablebases" << sync_endl;
+}
+
+
+/// FairyTablebases::probe_wdl() probes the WDL table of a pawnless position
+/// without gates or castling rights. The result is from the point of view of
+/// the side to move and ignores the 50-move counter of the position.
+
+WDLScore FairyTablebases::probe_wdl(Position& pos, ProbeState* result) {
+
+  if (pos.count<ALL_PIECES>() == 2) // KvK, no table is generated for it
+      return *result = OK, WDLDraw;
+
+  uint64_t idx;
+  const ProbeTable* t = probe_table(pos, idx);
+
+  *result = t ? OK : FAIL;
+  return t ? WDLScore(t->symbol(WDL, idx) - 2) : WDLDraw;
+}
+
+
+/// FairyTablebases::probe_dtz() probes the DTZ table: the number of plies to
+/// the mate or the next capture, with the sign of the WDL score. It is 0 for
+/// draws and for positions where the side to move is mated.
+
+int FairyTablebases::probe_dtz(Position& pos, ProbeState* result) {
+
+  if (pos.count<ALL_PIECES>() == 2) // KvK
+      return *result = OK, 0;
+
+  uint64_t idx;
+  const ProbeTable* t = probe_table(pos, idx);
+
+  if (!t || !t->data[DTZ])
+  {
+      *result = FAIL;
+      return 0;
+  }
+
+  *result = OK;
+  int wdl = t->symbol(WDL, idx) - 2;
+
+  return wdl > 0 ?  t->symbol(DTZ, idx)
+       : wdl < 0 ? -t->symbol(DTZ, idx) : 0;
+}
+
+
+/// FairyTablebases::root_probe() ranks the root moves with the DTZ tables, the
+/// same way as Tablebases::root_probe(). It returns false if a probe failed.
+
+bool FairyTablebases::root_probe(Position& pos, Search::RootMoves& rootMoves) {
+
+  ProbeState result = OK;
+  StateInfo st;
+
+  int cnt50 = pos.rule50_count();
+  bool rep = pos.has_repeated();
+  int dtz, bound = Options["Syzygy50MoveRule"] ? 900 : 1;
+
+  for (auto& m : rootMoves)
+  {
+      pos.do_move(m.pv[0], st);
+
+      // A mating move has a dtz of 1, and a capture one of -101/-1/0/1/101
+      if (pos.checkers() && MoveList<LEGAL>(pos).size() == 0)
+          dtz = 1;
+
+      else if (pos.rule50_count() == 0)
+      {
+          WDLScore wdl = WDLScore(-FairyTablebases::probe_wdl(pos, &result));
+          dtz =  wdl == WDLWin         ?  1 : wdl == WDLCursedWin ?  101
+               : wdl == WDLBlessedLoss ? -101 : wdl == WDLLoss   ? -1 : 0;
+      }
+      else
+      {
+          dtz = -FairyTablebases::probe_dtz(pos, &result);
+          dtz =  dtz > 0 ? dtz + 1
+               : dtz < 0 ? dtz - 1 : dtz;
+      }
+
+      pos.undo_move(m.pv[0]);
+
+      if (result == FAIL)
+          return false;
+
+      int r =  dtz > 0 ? (dtz + cnt50 <= 99 && !rep ? 1000 : 1000 - (dtz + cnt50))
+             : dtz < 0 ? (-dtz * 2 + cnt50 < 100 ? -1000 : -1000 + (-dtz + cnt50))
+             : 0;
+      m.tbRank = r;
+
+      m.tbScore =  r >= bound ? VALUE_MATE - MAX_PLY - 1
+                 : r >  0     ? Value((std::max( 3, r - 800) * int(PawnValueEg)) / 200)
+                 : r == 0     ? VALUE_DRAW
+                 : r > -bound ? Value((std::min(-3, r + 800) * int(PawnValueEg)) / 200)
+                 :             -VALUE_MATE + MAX_PLY + 1;
+  }
+
+  return true;
+}
+
+
+/// FairyTablebases::generate() builds the tables of an endgame given by a code
+/// like "KAvKR", and the tables of the endgames reached by captures, and writes
+/// them in 'dir'. All the positions of the endgame are held in memory with two
+/// bytes each: about 1 GB for five pieces if the board can be mirrored.
+
+void FairyTablebases::generate(const std::string& code, const std::string& dir) {
+
+  std::string c = canonical(code);
+
+  if (c.empty())
+  {
+      sync_cout << "info string Cannot generate " << code
+                << ": pawnless endgames of up to " << TBPIECES << " pieces only" << sync_endl;
+      return;
+  }
+
+  for (char ch : c)
+      if (ch != 'v' && !symmetric(piece_type(ch), 56, true))
+      {
+          sync_cout << "info string Cannot generate " << c
+                    << ": the moves of " << ch << " differ between the colors" << sync_endl;
+          return;
+      }
+
+  Generators tables;
+  get_table(c, tables, std::max(1u, unsigned(Options["Threads"])));
+
+  for (const auto& t : tables)
+      if (t.second->layout.count > 2)
+          t.second->write(dir);
+}
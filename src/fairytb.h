@@ -0,0 +1,48 @@
+/*
+  Stockfish, a UCI chess playing engine derived from Glaurung 2.1
+  Copyright (C) 2004-2008 Tord Romstad (Glaurung author)
+  Copyright (C) 2008-2015 Marco Costalba, Joona Kiiski, Tord Romstad
+  Copyright (C) 2015-2018 Marco Costalba, Joona Kiiski, Gary Linscott, Tord Romstad
+
+  Stockfish is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Stockfish is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef FAIRYTB_H_INCLUDED
+#define FAIRYTB_H_INCLUDED
+
+#include <string>
+
+#include "search.h"
+#include "syzygy/tbprobe.h"
+
+/// FairyTablebases are WDL and DTZ tables for the pawnless endgames of up to
+/// five pieces, Musketeer fairy pieces included, that the Syzygy tables do not
+/// cover. The tables are built by generate() and stored in .mtbw (WDL) and
+/// .mtbz (DTZ) files, which the probing code memory maps.
+
+namespace FairyTablebases {
+
+constexpr int TBPIECES = 5;
+
+extern int MaxCardinality;
+
+void init(const std::string& paths);
+Tablebases::WDLScore probe_wdl(Position& pos, Tablebases::ProbeState* result);
+int probe_dtz(Position& pos, Tablebases::ProbeState* result);
+bool root_probe(Position& pos, Search::RootMoves& rootMoves);
+void generate(const std::string& code, const std::string& dir);
+
+}
+
+#endif // #ifndef FAIRYTB_H_INCLUDED
@@ -21,6 +21,7 @@
 #include <iostream>
 
 #include "bitboard.h"
+#include "fairytb.h"
 #include "position.h"
 #include "search.h"
 #include "thread.h"
@@ -45,6 +46,7 @@ int main(int argc, char* argv[]) {
   Search::init();
   Pawns::init();
   Tablebases::init(Options["SyzygyPath"]); // After Bitboards are set
+  FairyTablebases::init(Options["FairyTBPath"]);
   Threads.set(Options["Threads"]);
   Search::clear(); // After threads are up
 
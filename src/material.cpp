@@ -59,6 +59,7 @@ namespace {
   // Endgame evaluation and scaling functions are accessed directly and not through
   // the function maps because they correspond to more than one material hash key.
   Endgame<KXK>    EvaluateKXK[] = { Endgame<KXK>(WHITE),    Endgame<KXK>(BLACK) };
+  Endgame<KXKP>   EvaluateKXKP[] = { Endgame<KXKP>(WHITE),  Endgame<KXKP>(BLACK) };
 
   Endgame<KBPsK>  ScaleKBPsK[]  = { Endgame<KBPsK>(WHITE),  Endgame<KBPsK>(BLACK) };
   Endgame<KQKRPs> ScaleKQKRPs[] = { Endgame<KQKRPs>(WHITE), Endgame<KQKRPs>(BLACK) };
@@ -71,6 +72,15 @@ namespace {
           && pos.non_pawn_material(us) >= RookValueMg;
   }
 
+  bool is_KXKP(const Position& pos, Color us) {
+    Bitboard x = pos.pieces(us) ^ pos.pieces(us, KING);
+    PieceType pt = x ? type_of(pos.piece_on(lsb(x))) : NO_PIECE_TYPE;
+    return   !more_than_one(x)
+          && pt > QUEEN && pt < KING
+          && pos.count<PAWN>(~us) == 1
+          && !pos.non_pawn_material(~us);
+  }
+
   bool is_KBPsK(const Position& pos, Color us) {
     return   pos.non_pawn_material(us) == BishopValueMg
           && pos.count<BISHOP>(us) == 1
@@ -154,6 +164,13 @@ Entry* probe(const Position& pos) {
           return e;
       }
 
+  for (Color c = WHITE; c <= BLACK; ++c)
+      if (is_KXKP(pos, c))
+      {
+          e->evaluationFunction = &EvaluateKXKP[c];
+          return e;
+      }
+
   // OK, we didn't find any special evaluation function for the current material
   // configuration. Is there a suitable specialized scaling function?
   EndgameBase<ScaleFactor>* sf;
@@ -41,6 +41,16 @@ typedef bool(*fun3_t)(HANDLE, CONST GROUP_AFFINITY*, PGROUP_AFFINITY);
 }
 #endif
 
+#if defined(__linux__) && !defined(__ANDROID__)
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+#include <dirent.h>
+#include <sched.h>
+#include <sys/mman.h>
+#endif
+
+#include <algorithm>
 #include <fstream>
 #include <iomanip>
 #include <iostream>
@@ -216,11 +226,225 @@ void prefetch2(void* addr) {
   prefetch((uint8_t*)addr + 64);
 }
 
+
+/// large_pages_alloc() allocates a big table such as the transposition table,
+/// aligned to at least 64 bytes. With mode "Auto" it first tries explicit huge
+/// pages (1 GB, then 2 MB), which need to be reserved by the administrator via
+/// vm.nr_hugepages. With "Auto" or "Transparent" it then asks the kernel for
+/// transparent huge pages, and otherwise falls back to normal pages. The kind
+/// of pages used is returned in 'kind' and must be passed to large_pages_free().
+
+#if defined(__linux__) && !defined(__ANDROID__)
+
+#ifndef MAP_HUGE_SHIFT
+#define MAP_HUGE_SHIFT 26
+#endif
+
+namespace {
+
+constexpr size_t TwoMB = size_t(1) << 21;
+constexpr size_t OneGB = size_t(1) << 30;
+
+size_t round_up(size_t size, size_t pageSize) {
+  return (size + pageSize - 1) / pageSize * pageSize;
+}
+
+void* huge_pages_mmap(size_t size, size_t pageSize, int log2PageSize) {
+
+  void* mem = mmap(nullptr, round_up(size, pageSize), PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | (log2PageSize << MAP_HUGE_SHIFT), -1, 0);
+  return mem != MAP_FAILED ? mem : nullptr;
+}
+
+} // namespace
+
+#endif
+
+void* large_pages_alloc(size_t size, const string& mode, PageKind& kind) {
+
+#if defined(__linux__) && !defined(__ANDROID__)
+  void* mem = nullptr;
+
+  // 1 GB pages only when they are completely used
+  if (mode == "Auto" && size % OneGB == 0 && (mem = huge_pages_mmap(size, OneGB, 30)))
+      return kind = HUGE_PAGES_1GB, mem;
+
+  if (mode == "Auto" && size >= TwoMB && (mem = huge_pages_mmap(size, TwoMB, 21)))
+      return kind = HUGE_PAGES_2MB, mem;
+
+  if (mode != "Off" && size >= TwoMB && !posix_memalign(&mem, TwoMB, round_up(size, TwoMB)))
+  {
+      madvise(mem, round_up(size, TwoMB), MADV_HUGEPAGE);
+      return kind = TRANSPARENT_HUGE_PAGES, mem;
+  }
+#else
+  (void)mode;
+#endif
+
+  // Normal pages: keep the pointer returned by malloc() just before the
+  // aligned block, so that large_pages_free() can release it.
+  constexpr size_t Alignment = 64;
+  void* raw = malloc(size + Alignment + sizeof(void*));
+
+  if (!raw)
+      return nullptr;
+
+  void** aligned = (void**)((uintptr_t((char*)raw + sizeof(void*)) + Alignment - 1) & ~(Alignment - 1));
+  aligned[-1] = raw;
+  kind = NORMAL_PAGES;
+  return aligned;
+}
+
+
+/// large_pages_free() releases memory returned by large_pages_alloc()
+
+void large_pages_free(void* mem, size_t size, PageKind kind) {
+
+  if (!mem)
+      return;
+
+#if defined(__linux__) && !defined(__ANDROID__)
+  if (kind == HUGE_PAGES_1GB || kind == HUGE_PAGES_2MB)
+  {
+      munmap(mem, round_up(size, kind == HUGE_PAGES_1GB ? OneGB : TwoMB));
+      return;
+  }
+  if (kind == TRANSPARENT_HUGE_PAGES)
+  {
+      free(mem);
+      return;
+  }
+#else
+  (void)size;
+#endif
+
+  free(((void**)mem)[-1]);
+}
+
 namespace WinProcGroup {
 
-#ifndef _WIN32
+#if defined(__linux__) && !defined(__ANDROID__)
+
+/// read_cpu_list() reads a Linux cpulist file like "0-3,8-11" and returns the
+/// listed logical CPUs, or none if the file is missing.
+
+vector<int> read_cpu_list(const string& path) {
+
+  vector<int> cpus;
+  ifstream file(path);
+  string range;
+
+  while (getline(file, range, ','))
+  {
+      istringstream ss(range);
+      int first, last;
+      char dash;
+
+      if (!(ss >> first))
+          break;
+
+      if (!(ss >> dash >> last))
+          last = first;
+
+      for (int c = first; c <= last; ++c)
+          cpus.push_back(c);
+  }
+
+  return cpus;
+}
+
+
+/// get_cpus() returns the logical CPUs to bind the thread with index idx to.
+/// As on Windows, threads fill the physical cores of a NUMA node before moving
+/// on to the next node, then the remaining SMT siblings are spread evenly across
+/// the nodes. With toCore the thread gets the single CPU of its slot, otherwise
+/// all the CPUs of the node of its slot. Only the CPUs we are allowed to run on
+/// are used, and no CPU is returned when there are more threads than CPUs.
+
+vector<int> get_cpus(size_t idx, bool toCore) {
+
+  cpu_set_t allowed;
+  if (sched_getaffinity(0, sizeof(allowed), &allowed))
+      return {};
+
+  vector<int> nodeIds;
+  if (DIR* dir = opendir("/sys/devices/system/node"))
+  {
+      while (dirent* entry = readdir(dir))
+          if (!strncmp(entry->d_name, "node", 4) && isdigit(entry->d_name[4]))
+              nodeIds.push_back(atoi(entry->d_name + 4));
+
+      closedir(dir);
+  }
+
+  sort(nodeIds.begin(), nodeIds.end());
+
+  vector<vector<int>> nodes;
+  for (int id : nodeIds)
+      nodes.push_back(read_cpu_list("/sys/devices/system/node/node" + to_string(id) + "/cpulist"));
+
+  if (nodes.empty())
+      nodes.push_back(read_cpu_list("/sys/devices/system/cpu/online"));
+
+  // Drop the CPUs we may not use, and the nodes left without any
+  for (auto& cpus : nodes)
+      cpus.erase(remove_if(cpus.begin(), cpus.end(), [&](int c) {
+                     return c >= CPU_SETSIZE || !CPU_ISSET(c, &allowed); }), cpus.end());
+
+  nodes.erase(remove_if(nodes.begin(), nodes.end(), [](const vector<int>& cpus) {
+                  return cpus.empty(); }), nodes.end());
+
+  // A CPU is the first of its core if it is the lowest of its SMT siblings
+  vector<pair<size_t, int>> slots; // (node, cpu)
+  vector<vector<int>> siblings(nodes.size());
+
+  for (size_t n = 0; n < nodes.size(); ++n)
+      for (int c : nodes[n])
+      {
+          vector<int> sib = read_cpu_list("/sys/devices/system/cpu/cpu" + to_string(c)
+                                         + "/topology/thread_siblings_list");
+          if (sib.empty() || sib[0] == c)
+              slots.emplace_back(n, c);
+          else
+              siblings[n].push_back(c);
+      }
+
+  for (size_t t = 0, more = true; more; ++t)
+  {
+      more = false;
+      for (size_t n = 0; n < nodes.size(); ++n)
+          if (t < siblings[n].size())
+              slots.emplace_back(n, siblings[n][t]), more = true;
+  }
+
+  if (idx >= slots.size())
+      return {};
+
+  return toCore ? vector<int>{ slots[idx].second } : nodes[slots[idx].first];
+}
+
+
+/// bindThisThread() sets the CPU affinity of the current thread
+
+void bindThisThread(size_t idx, bool toCore) {
+
+  vector<int> cpus = get_cpus(idx, toCore);
+
+  if (cpus.empty())
+      return;
+
+  cpu_set_t set;
+  CPU_ZERO(&set);
+
+  for (int c : cpus)
+      CPU_SET(c, &set);
+
+  sched_setaffinity(0, sizeof(set), &set);
+}
+
+#elif !defined(_WIN32)
 
-void bindThisThread(size_t) {}
+void bindThisThread(size_t, bool) {}
 
 #else
 
@@ -296,7 +520,7 @@ int get_group(size_t idx) {
 
 /// bindThisThread() set the group affinity of the current thread
 
-void bindThisThread(size_t idx) {
+void bindThisThread(size_t idx, bool) {
 
   // Use only local variables to be thread-safe
   int group = get_group(idx);
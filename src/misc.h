@@ -34,6 +34,10 @@ void prefetch(void* addr);
 void prefetch2(void* addr);
 void start_logger(const std::string& fname);
 
+enum PageKind { NORMAL_PAGES, TRANSPARENT_HUGE_PAGES, HUGE_PAGES_2MB, HUGE_PAGES_1GB };
+void* large_pages_alloc(size_t size, const std::string& mode, PageKind& kind);
+void large_pages_free(void* mem, size_t size, PageKind kind);
+
 void dbg_hit_on(bool b);
 void dbg_hit_on(bool c, bool b);
 void dbg_mean_of(int v);
@@ -105,10 +109,11 @@ public:
 /// logical processor group. This usually means to be limited to use max 64
 /// cores. To overcome this, some special platform specific API should be
 /// called to set group affinity for each thread. Original code from Texel by
-/// Peter Österlund.
+/// Peter Österlund. On Linux the same placement binds threads to the CPUs of
+/// a NUMA node, or with toCore to a single CPU, physical cores first.
 
 namespace WinProcGroup {
-  void bindThisThread(size_t idx);
+  void bindThisThread(size_t idx, bool toCore);
 }
 
 #endif // #ifndef MISC_H_INCLUDED
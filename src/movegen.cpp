@@ -231,7 +231,27 @@ namespace {
   }
 
 
-  template<bool Checks>
+  // pin_ray() returns the squares a pinned piece on 'from' can move to without
+  // exposing its king: those between the king and the pinner, and the pinner.
+  // Squares beyond the pinner are excluded, as a leaper could jump over it.
+  Bitboard pin_ray(const Position& pos, Color us, Square from) {
+
+    Square ksq = pos.square<KING>(us);
+    Bitboard pinners = pos.pinners(~us);
+
+    while (pinners)
+    {
+        Square s = pop_lsb(&pinners);
+        if (between_bb(ksq, s) & from)
+            return between_bb(ksq, s) | s;
+    }
+
+    assert(false);
+    return 0;
+  }
+
+
+  template<bool Checks, bool Legal = false>
   ExtMove* generate_moves(const Position& pos, ExtMove* moveList, Color us, PieceType pt,
                           Bitboard target) {
 
@@ -250,6 +270,10 @@ namespace {
         if (Checks)
             b &= pos.check_squares(pt);
 
+        // A pinned piece may only move along the ray of its pinner
+        if (Legal && (pos.blockers_for_king(us) & from))
+            b &= pin_ray(pos, us, from);
+
         while (b)
             *moveList++ = make_move(from, pop_lsb(&b));
     }
@@ -264,8 +288,8 @@ namespace {
     constexpr bool Checks = Type == QUIET_CHECKS;
 
     moveList = generate_pawn_moves<Us, Type>(pos, moveList, target);
-    for (PieceType pt = KNIGHT; pt < KING; ++pt)
-        moveList = generate_moves<Checks>(pos, moveList, Us, pt, target);
+    for (const PieceType* pt = pos.piece_types(); *pt; ++pt)
+        moveList = generate_moves<Checks>(pos, moveList, Us, *pt, target);
 
     if (Type != QUIET_CHECKS && Type != EVASIONS)
     {
@@ -292,6 +316,49 @@ namespace {
     return moveList;
   }
 
+
+  // generate_legal() generates the legal moves other than king steps. The
+  // target holds the squares that resolve a check, or all the squares not
+  // occupied by us. Pawn moves are generated setwise, so those of pinned pawns
+  // are dropped afterwards, as are the rare illegal en passant captures.
+  template<Color Us>
+  ExtMove* generate_legal(const Position& pos, ExtMove* moveList, Bitboard target) {
+
+    Bitboard pinnedPawns = pos.blockers_for_king(Us) & pos.pieces(Us, PAWN);
+    ExtMove* cur = moveList;
+
+    moveList = generate_pawn_moves<Us, EVASIONS>(pos, moveList, target);
+
+    if (pinnedPawns || pos.ep_square() != SQ_NONE)
+    {
+        while (cur != moveList)
+            if (   ((pinnedPawns & from_sq(*cur)) && !(pin_ray(pos, Us, from_sq(*cur)) & to_sq(*cur)))
+                || (type_of(*cur) == ENPASSANT && !pos.legal(*cur)))
+                *cur = (--moveList)->move;
+            else
+                ++cur;
+    }
+
+    for (const PieceType* pt = pos.piece_types(); *pt; ++pt)
+        moveList = generate_moves<false, true>(pos, moveList, Us, *pt, target);
+
+    if (!pos.checkers() && pos.can_castle(Us))
+    {
+        if (pos.is_chess960())
+        {
+            moveList = generate_castling<MakeCastling<Us,  KING_SIDE>::right, false, true>(pos, moveList, Us);
+            moveList = generate_castling<MakeCastling<Us, QUEEN_SIDE>::right, false, true>(pos, moveList, Us);
+        }
+        else
+        {
+            moveList = generate_castling<MakeCastling<Us,  KING_SIDE>::right, false, false>(pos, moveList, Us);
+            moveList = generate_castling<MakeCastling<Us, QUEEN_SIDE>::right, false, false>(pos, moveList, Us);
+        }
+    }
+
+    return moveList;
+  }
+
 } // namespace
 
 
@@ -446,24 +513,48 @@ ExtMove* generate<PLACEMENTS>(const Position& pos, ExtMove* moveList) {
   return moveList;
 }
 
-/// generate<LEGAL> generates all the legal moves in the given position
+/// generate<LEGAL> generates all the legal moves in the given position. The
+/// squares attacked by the opponent and the pin rays are computed once, so that
+/// the king only steps to safe squares and pinned pieces stay on their ray.
 
 template<>
 ExtMove* generate<LEGAL>(const Position& pos, ExtMove* moveList) {
 
+  // Gating setup moves are all legal
+  if (pos.game_phase() != GAMEPHASE_PLAYING)
+      return pos.checkers() ? generate<EVASIONS    >(pos, moveList)
+                            : generate<NON_EVASIONS>(pos, moveList);
+
   Color us = pos.side_to_move();
-  Bitboard pinned = pos.blockers_for_king(us) & pos.pieces(us);
   Square ksq = pos.square<KING>(us);
-  ExtMove* cur = moveList;
+  Bitboard occupied = pos.pieces() ^ ksq;
+  Bitboard danger = 0;
 
-  moveList = pos.checkers() ? generate<EVASIONS    >(pos, moveList)
-                            : generate<NON_EVASIONS>(pos, moveList);
-  while (cur != moveList)
-      if (   (pinned || from_sq(*cur) == ksq || type_of(*cur) == ENPASSANT)
-          && !pos.legal(*cur))
-          *cur = (--moveList)->move;
-      else
-          ++cur;
+  // Remove our king from the board, so that it can not step back along the
+  // line of a checking slider.
+  for (Bitboard b = pos.pieces(~us); b; )
+  {
+      Square s = pop_lsb(&b);
+      danger |= attacks_bb(~us, type_of(pos.piece_on(s)), s, occupied);
+  }
 
-  return moveList;
+  Bitboard b = pos.attacks_from<KING>(us, ksq) & ~pos.pieces(us) & ~danger;
+  while (b)
+      *moveList++ = make_move(ksq, pop_lsb(&b));
+
+  Bitboard target = ~pos.pieces(us);
+
+  if (pos.checkers())
+  {
+      if (more_than_one(pos.checkers()))
+          return moveList; // Double check, only a king move can save the day
+
+      // Block the check or capture the checking piece. Leaper attacks can not be blocked.
+      Square checksq = lsb(pos.checkers());
+      target = LeaperAttacks[~us][type_of(pos.piece_on(checksq))][checksq] & ksq
+             ? SquareBB[checksq] : between_bb(checksq, ksq) | checksq;
+  }
+
+  return us == WHITE ? generate_legal<WHITE>(pos, moveList, target)
+                     : generate_legal<BLACK>(pos, moveList, target);
 }
@@ -24,6 +24,7 @@
 #include <array>
 #include <limits>
 #include <type_traits>
+#include <vector>
 
 #include "movegen.h"
 #include "position.h"
@@ -75,6 +76,37 @@ struct Stats : public std::array<Stats<T, D, Sizes...>, Size>
 template <typename T, int D, int Size>
 struct Stats<T, D, Size> : public std::array<StatsEntry<T, D>, Size> {
   T* get() { return this->at(0).get(); }
+
+  void fill(const T& v) {
+    T* p = get();
+    std::fill(p, p + Size, v);
+  }
+};
+
+/// PieceStats is a Stats table whose first dimension is addressed by a Piece
+/// through its dense PieceIndex. The number of pieces in play is only known at
+/// runtime, so the rows live in a vector that fill() resizes to PieceIndexNb:
+/// footprint and clearing cost follow the piece set, not PIECE_NB.
+template <typename T, int D, int... Sizes>
+struct PieceStats : public std::vector<Stats<T, D, Sizes...>>
+{
+  typedef Stats<T, D, Sizes...> Row;
+
+  Row& operator[](Piece pc) {
+    assert(PieceIndex[pc] < this->size());
+    return this->std::vector<Row>::operator[](PieceIndex[pc]);
+  }
+
+  const Row& operator[](Piece pc) const {
+    assert(PieceIndex[pc] < this->size());
+    return this->std::vector<Row>::operator[](PieceIndex[pc]);
+  }
+
+  void fill(const T& v) {
+    this->resize(PieceIndexNb);
+    for (Row& row : *this)
+        row.fill(v);
+  }
 };
 
 /// In stats table, D=0 means that the template parameter is not used
@@ -89,18 +121,53 @@ typedef Stats<int16_t, 10368, COLOR_NB, int(SQUARE_NB) * int(SQUARE_NB)> Butterf
 
 /// CounterMoveHistory stores counter moves indexed by [piece][to] of the previous
 /// move, see chessprogramming.wikispaces.com/Countermove+Heuristic
-typedef Stats<Move, NOT_USED, PIECE_NB, SQUARE_NB> CounterMoveHistory;
+typedef PieceStats<Move, NOT_USED, SQUARE_NB> CounterMoveHistory;
+
+/// CapturePieceToHistory is addressed by a move's [piece][to][captured piece type].
+/// Like PieceStats its size follows the piece set: the piece is addressed by its
+/// PieceIndex and the captured types, contiguous from NO_PIECE_TYPE, only span
+/// [0, PieceTypeEnd) instead of PIECE_TYPE_NB. fill() sets both dimensions.
+class CapturePieceToHistory {
+
+  typedef StatsEntry<int16_t, 10368> Entry;
+
+  template<typename E>
+  struct Row {
+    E* entries;
+    int types;
 
-/// CapturePieceToHistory is addressed by a move's [piece][to][captured piece type]
-typedef Stats<int16_t, 10368, PIECE_NB, SQUARE_NB, PIECE_TYPE_NB> CapturePieceToHistory;
+    E* operator[](Square to) const { return entries + to * types; }
+  };
+
+  std::vector<Entry> table;
+  int types = 0;
+
+public:
+  Row<Entry> operator[](Piece pc) {
+    assert(size_t(PieceIndex[pc] + 1) * SQUARE_NB * types <= table.size());
+    return { &table[size_t(PieceIndex[pc]) * SQUARE_NB * types], types };
+  }
+
+  Row<const Entry> operator[](Piece pc) const {
+    assert(size_t(PieceIndex[pc] + 1) * SQUARE_NB * types <= table.size());
+    return { &table[size_t(PieceIndex[pc]) * SQUARE_NB * types], types };
+  }
+
+  void fill(int16_t v) {
+    Entry e;
+    e = v;
+    types = PieceTypeEnd;
+    table.assign(size_t(PieceIndexNb) * SQUARE_NB * types, e);
+  }
+};
 
 /// PieceToHistory is like ButterflyHistory but is addressed by a move's [piece][to]
-typedef Stats<int16_t, 29952, PIECE_NB, SQUARE_NB> PieceToHistory;
+typedef PieceStats<int16_t, 29952, SQUARE_NB> PieceToHistory;
 
 /// ContinuationHistory is the combined history of a given pair of moves, usually
 /// the current one given a previous one. The nested history table is based on
 /// PieceToHistory instead of ButterflyBoards.
-typedef Stats<PieceToHistory, NOT_USED, PIECE_NB, SQUARE_NB> ContinuationHistory;
+typedef PieceStats<PieceToHistory, NOT_USED, SQUARE_NB> ContinuationHistory;
 
 
 /// MovePicker class is used to pick one pseudo legal move at a time from the
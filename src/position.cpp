@@ -21,7 +21,7 @@
 #include <algorithm>
 #include <cassert>
 #include <cstddef> // For offsetof()
-#include <cstring> // For std::memset, std::memcmp
+#include <cstring> // For std::memset, std::memcmp, std::memcpy
 #include <iomanip>
 #include <sstream>
 #include <vector>
@@ -59,34 +59,33 @@ namespace {
 // valuable attacker for the side to move, remove the attacker we just found
 // from the bitboards and scan for new X-ray attacks behind it.
 
-template<int Pt>
-PieceType min_attacker(const Bitboard* byTypeBB, Square to, Bitboard stmAttackers,
+PieceType min_attacker(const Position& pos, Square to, Bitboard stmAttackers,
                        Bitboard& occupied, Bitboard& attackers) {
 
-  Bitboard b = stmAttackers & byTypeBB[Pt];
-  if (!b)
-      return min_attacker<Pt + 1>(byTypeBB, to, stmAttackers, occupied, attackers);
+  const PieceType* pt = SeeOrder;
+  Bitboard b;
 
-  occupied ^= lsb(b); // Remove the attacker from occupied
+  while (!(b = stmAttackers & pos.pieces(*pt)))
+      ++pt;
 
-  // Add any X-ray attack behind the just removed piece. For instance with
-  // rooks in a8 and a7 attacking a1, after removing a7 we add rook in a8.
-  // Note that new added attackers can be of any color.
-  if (Pt == PAWN || Pt == BISHOP || Pt == QUEEN)
-      attackers |= attacks_bb<BISHOP>(to, occupied) & (byTypeBB[BISHOP] | byTypeBB[QUEEN]);
+  if (*pt == KING)
+      return KING; // No need to update bitboards: it is the last cycle
 
-  if (Pt == ROOK || Pt == QUEEN)
-      attackers |= attacks_bb<ROOK>(to, occupied) & (byTypeBB[ROOK] | byTypeBB[QUEEN]);
+  Square s = lsb(b);
+  occupied ^= s; // Remove the attacker from occupied
 
-  // X-ray may add already processed pieces because byTypeBB[] is constant: in
-  // the rook example, now attackers contains _again_ rook in a7, so remove it.
+  // Add any X-ray attack behind the just removed piece. For instance with
+  // rooks in a8 and a7 attacking a1, after removing a7 we add rook in a8.
+  // Any piece with a slide along the line may be uncovered, also a range
+  // limited or compound one, and new added attackers can be of any color.
+  if (PseudoAttacks[WHITE][QUEEN][to] & s)
+      attackers |= pos.attackers_to(to, occupied);
+
+  // X-ray may add already processed pieces because the piece bitboards are
+  // constant: in the rook example, now attackers contains _again_ rook in a7,
+  // so remove it.
   attackers &= occupied;
-  return (PieceType)Pt;
-}
-
-template<>
-PieceType min_attacker<KING>(const Bitboard*, Square, Bitboard, Bitboard&, Bitboard&) {
-  return KING; // No need to update bitboards: it is the last cycle
+  return *pt;
 }
 
 } // namespace
@@ -134,13 +133,48 @@ std::ostream& operator<<(std::ostream& os, const Position& pos) {
 // situations. Description of the algorithm in the following paper:
 // https://marcelk.net/2013-04-06/paper/upcoming-rep-v2.pdf
 
+namespace {
+
+// The size of the cuckoo tables depends on the pieces in play, see init_cuckoo()
+int CuckooMask;
+
 // First and second hash functions for indexing the cuckoo tables
-inline int H1(Key h) { return h & 0x1fff; }
-inline int H2(Key h) { return (h >> 16) & 0x1fff; }
+inline int H1(Key h) { return h & CuckooMask; }
+inline int H2(Key h) { return (h >> 16) & CuckooMask; }
 
 // Cuckoo tables with Zobrist hashes of valid reversible moves, and the moves themselves
-Key cuckoo[8192];
-Move cuckooMove[8192];
+std::vector<Key> cuckoo;
+std::vector<Move> cuckooMove;
+
+// fill_cuckoo() stores the given moves in cuckoo tables of the given size. It
+// fails if an insertion keeps pushing victims around, then a bigger size is needed.
+bool fill_cuckoo(const std::vector<std::pair<Key, Move>>& moves, size_t size) {
+
+  cuckoo.assign(size, 0);
+  cuckooMove.assign(size, MOVE_NONE);
+  CuckooMask = int(size - 1);
+
+  for (auto entry : moves)
+  {
+      Key key = entry.first;
+      Move move = entry.second;
+      int i = H1(key);
+
+      for (int kicks = 0; true; ++kicks)
+      {
+          std::swap(cuckoo[i], key);
+          std::swap(cuckooMove[i], move);
+          if (move == 0)   // Arrived at empty slot ?
+              break;
+          if (kicks > 1000)
+              return false;
+          i = (i == H1(key)) ? H2(key) : H1(key); // Push victim to alternative slot
+      }
+  }
+  return true;
+}
+
+} // namespace
 
 
 /// Position::init() initializes at startup the various arrays used to compute
@@ -181,31 +215,52 @@ void Position::init() {
   Zobrist::side = rng.rand<Key>();
   Zobrist::noPawns = rng.rand<Key>();
 
-  // Prepare the cuckoo tables
-  int count = 0;
+  // Keys for the custom piece types come last to keep the other ones stable
   for (Color c = WHITE; c <= BLACK; ++c)
-      for (PieceType pt = KNIGHT; pt <= QUEEN || pt == KING; pt != QUEEN ? ++pt: pt = KING)
+      for (PieceType pt = CUSTOM_1; pt < PIECE_TYPE_NB; ++pt)
       {
-      Piece pc = make_piece(c, pt);
-      for (Square s1 = SQ_A1; s1 <= SQ_H8; ++s1)
-          for (Square s2 = Square(s1 + 1); s2 <= SQ_H8; ++s2)
-              if (PseudoAttacks[WHITE][type_of(pc)][s1] & s2)
-              {
-                  Move move = make_move(s1, s2);
-                  Key key = Zobrist::psq[pc][s1] ^ Zobrist::psq[pc][s2] ^ Zobrist::side;
-                  int i = H1(key);
-                  while (true)
-                  {
-                      std::swap(cuckoo[i], key);
-                      std::swap(cuckooMove[i], move);
-                      if (move == 0)   // Arrived at empty slot ?
-                          break;
-                      i = (i == H1(key)) ? H2(key) : H1(key); // Push victim to alternative slot
-                  }
-                  count++;
-             }
+          for (Square s = SQ_A1; s <= SQ_H8; ++s)
+              Zobrist::psq[make_piece(c, pt)][s] = rng.rand<Key>();
+
+          for (File f = FILE_A; f <= FILE_H; ++f)
+              Zobrist::psq_gate[make_piece(c, pt)][f] = rng.rand<Key>();
       }
-  assert(count == 3668);
+
+  for (PieceType pt = CUSTOM_1; pt < PIECE_TYPE_NB; ++pt)
+      for (Gate g = NO_GATE; g < GATE_NB; ++g)
+          Zobrist::inhand[pt][g] = rng.rand<Key>();
+
+  init_cuckoo();
+}
+
+
+/// Position::init_cuckoo() fills the cuckoo tables with the reversible moves of
+/// all the piece types in play but pawns, built-in and custom ones. It is called
+/// again when custom pieces are registered. The tables get the smallest power of
+/// two size keeping them at most half full, doubled if the insertions fail.
+
+void Position::init_cuckoo() {
+
+  std::vector<std::pair<Key, Move>> moves;
+
+  for (Color c = WHITE; c <= BLACK; ++c)
+      for (PieceType pt = KNIGHT; pt < PieceTypeEnd; ++pt)
+      {
+          Piece pc = make_piece(c, pt);
+          for (Square s1 = SQ_A1; s1 <= SQ_H8; ++s1)
+              for (Square s2 = Square(s1 + 1); s2 <= SQ_H8; ++s2)
+                  if (   (PseudoAttacks[c][pt][s1] & s2)
+                      && (PseudoAttacks[c][pt][s2] & s1))
+                      moves.emplace_back(Zobrist::psq[pc][s1] ^ Zobrist::psq[pc][s2] ^ Zobrist::side,
+                                         make_move(s1, s2));
+      }
+
+  size_t size = 1;
+  while (size < 2 * moves.size())
+      size *= 2;
+
+  while (!fill_cuckoo(moves, size))
+      size *= 2;
 }
 
 
@@ -411,6 +466,7 @@ Position& Position::set(const string& fenStr, bool isChess960, StateInfo* si, Th
 
   chess960 = isChess960;
   thisThread = th;
+  set_piece_types();
   set_state(st);
 
   assert(pos_is_ok());
@@ -446,6 +502,29 @@ void Position::set_castling_right(Color c, Square rfrom) {
 }
 
 
+/// Position::set_piece_types() lists the piece types other than pawn and king
+/// that can be on the board for the rest of the game: the standard ones, the
+/// gating pieces, which are also the fairy promotions, and any other type on
+/// the board. Once the gating pieces are selected the list is fixed, so loops
+/// over it skip the types absent from the game.
+
+void Position::set_piece_types() {
+
+  uint64_t inPlay = (1ULL << KNIGHT) | (1ULL << BISHOP) | (1ULL << ROOK) | (1ULL << QUEEN);
+
+  for (Gate g = WHITE_GATE_1; g <= gateCount; ++g)
+      inPlay |= 1ULL << gatingPieces[g];
+
+  PieceType* list = pieceTypes;
+
+  for (PieceType pt = KNIGHT; pt < PieceTypeEnd; ++pt)
+      if (pt != KING && ((inPlay & (1ULL << pt)) || pieces(pt)))
+          *list++ = pt;
+
+  *list = NO_PIECE_TYPE;
+}
+
+
 /// Position::set_check_info() sets king attacks to detect if a move gives check
 
 void Position::set_check_info(StateInfo* si) const {
@@ -453,11 +532,27 @@ void Position::set_check_info(StateInfo* si) const {
   si->blockersForKing[WHITE] = slider_blockers(pieces(BLACK), square<KING>(WHITE), si->pinners[BLACK]);
   si->blockersForKing[BLACK] = slider_blockers(pieces(WHITE), square<KING>(BLACK), si->pinners[WHITE]);
 
+  set_check_squares(si);
+}
+
+
+/// Position::set_check_squares() sets the squares from where each piece type
+/// of the side to move would give check
+
+void Position::set_check_squares(StateInfo* si) const {
+
   Square ksq = square<KING>(~sideToMove);
+  Bitboard lines = attacks_bb<BISHOP>(ksq, pieces()) | attacks_bb<ROOK>(ksq, pieces());
+
+  // Only the types in play can give check, the others are left unset. Types
+  // the side to move does not have on the board get an empty entry. A piece
+  // entering through a gate or a promotion is tested directly by gives_check().
+  si->checkSquares[PAWN] = line_attacks_bb(~sideToMove, PAWN, ksq, lines);
+  si->checkSquares[KING] = 0;
 
-  for (PieceType pt = PAWN; pt < KING; ++pt)
-      si->checkSquares[pt] = attacks_from(~sideToMove, pt, ksq);
-  si->checkSquares[KING]   = 0;
+  for (const PieceType* pt = pieceTypes; *pt; ++pt)
+      si->checkSquares[*pt] = pieceCount[make_piece(sideToMove, *pt)]
+                             ? line_attacks_bb(~sideToMove, *pt, ksq, lines) : 0;
 }
 
 
@@ -514,7 +609,7 @@ void Position::set_state(StateInfo* si) const {
   }
 
   for (Color c = WHITE; c <= BLACK; ++c)
-      for (PieceType pt = PAWN; pt <= KING; ++pt)
+      for (PieceType pt = PAWN; pt < PieceTypeEnd; ++pt)
       {
           Piece pc = make_piece(c, pt);
           if (pt != PAWN && pt != KING)
@@ -547,6 +642,20 @@ Position& Position::set(const string& code, Color c, StateInfo* si) {
 }
 
 
+/// Position::set() is an overload to copy a position for another thread. The
+/// copy shares the StateInfo of 'pos', including the history of the moves that
+/// led to it, which is needed by repetition detection. Position owns no memory,
+/// so it is copied bitwise.
+
+Position& Position::set(const Position& pos, Thread* th) {
+
+  std::memcpy(static_cast<void*>(this), &pos, sizeof(Position));
+  thisThread = th;
+
+  return *this;
+}
+
+
 /// Position::fen() returns a FEN representation of the position. In case of
 /// Chess960 the Shredder-FEN notation is used. This is mainly a debugging function.
 
@@ -645,13 +754,21 @@ Bitboard Position::slider_blockers(Bitboard sliders, Square s, Bitboard& pinners
 
 /// Position::attackers_to() computes a bitboard of all pieces which attack a
 /// given square. Slider attacks use the occupied bitboard to indicate occupancy.
+/// Moves are symmetric within a movement component, so the squares a component
+/// reaches from 's' hold the pieces attacking 's' with it.
 
 Bitboard Position::attackers_to(Square s, Bitboard occupied) const {
 
+  Bitboard lines[] = { AllSquares, attacks_bb<BISHOP>(s, occupied), attacks_bb<ROOK>(s, occupied) };
   Bitboard b = 0;
-  for (Color c = WHITE; c <= BLACK; ++c)
-      for (PieceType pt = PAWN; pt <= KING; ++pt)
-          b |= attacks_bb(~c, pt, s, occupied) & pieces(c, pt);
+
+  for (int i = 0; i < ComponentNb; ++i)
+      b |= ComponentAttacks[i][s] & lines[ComponentKinds[i]] & byComponentBB[i];
+
+  for (const PieceType* pt = IrregularTypes; *pt; ++pt)
+      b |=  (line_attacks_bb(BLACK, *pt, s, lines[1] | lines[2]) & pieces(WHITE, *pt))
+          | (line_attacks_bb(WHITE, *pt, s, lines[1] | lines[2]) & pieces(BLACK, *pt));
+
   return b;
 }
 
@@ -708,7 +825,8 @@ bool Position::legal(Move m) const {
 
 /// Position::pseudo_legal() takes a random move and tests whether the move is
 /// pseudo legal. It is used to validate moves from TT that can be corrupted
-/// due to SMP concurrent access or hash position key aliasing.
+/// due to SMP concurrent access or hash position key aliasing. Each move type
+/// is validated directly, accepting the same moves as the move generators.
 
 bool Position::pseudo_legal(const Move m) const {
 
@@ -717,16 +835,67 @@ bool Position::pseudo_legal(const Move m) const {
   Square to = to_sq(m);
   Piece pc = moved_piece(m);
 
-  // Use a slower but simpler function for uncommon cases
-  if (type_of(m) != NORMAL)
-      return MoveList<LEGAL>(*this).contains(m);
+  // Gating setup moves are generated only in their phase and out of check
+  if (type_of(m) == SET_GATING_TYPE)
+      return   game_phase() == GAMEPHASE_SELECTION
+            && !checkers()
+            && to == SQ_A1
+            && gating_type(m) > QUEEN
+            && gating_type(m) < KING;
+
+  if (type_of(m) == PUT_GATING_PIECE)
+  {
+      if (   game_phase() != GAMEPHASE_PLACING
+          || checkers()
+          || gating_type(m) != gating_piece(Gate(setup_count(us) + 1))
+          || rank_of(to) != relative_rank(us, RANK_1)
+          || (gates() & to))
+          return false;
+
+      // King and rook are mutually exclusive gates
+      if (pieces(us, KING) & gates())
+          return !(pieces(us, ROOK) & to);
+
+      return !(pieces(us, ROOK) & gates()) || !(pieces(us, KING) & to);
+  }
 
-  // A normal move during setup phase can not be legal
+  // Any other move during setup phase can not be legal
   if (game_phase() != GAMEPHASE_PLAYING)
       return false;
 
-  // Is not a promotion, so promotion piece must be empty
-  if (promotion_type(m) != NO_PIECE_TYPE)
+  // Castling moves are generated only when legal, so we have to check here
+  // that the king does not leave, cross or land on an attacked square.
+  if (type_of(m) == CASTLING)
+  {
+      CastlingRight cr = us | (to > from ? KING_SIDE : QUEEN_SIDE);
+
+      if (   checkers()
+          || from != square<KING>(us)
+          || !can_castle(cr)
+          || castling_rook_square(cr) != to
+          || castling_impeded(cr))
+          return false;
+
+      Square kto = relative_square(us, to > from ? SQ_G1 : SQ_C1);
+      Direction step = kto > from ? WEST : EAST;
+
+      for (Square s = kto; s != from; s += step)
+          if (attackers_to(s) & pieces(~us))
+              return false;
+
+      return !chess960 || !(attackers_to(kto, pieces() ^ to) & pieces(~us));
+  }
+
+  // An en passant capture can be an evasion only if the checking piece is the
+  // double pushed pawn. Discovered checks are left to legal().
+  if (type_of(m) == ENPASSANT)
+      return   to == ep_square()
+            && pc == make_piece(us, PAWN)
+            && (attacks_from<PAWN>(us, from) & to)
+            && (!checkers() || checkers() == SquareBB[to - pawn_push(us)]);
+
+  // Any other move type comes from a corrupted move
+  if (type_of(m) != NORMAL && type_of(m) != PROMOTION)
       return false;
 
   // If the 'from' square is not occupied by a piece belonging to the side to
@@ -741,9 +910,9 @@ bool Position::pseudo_legal(const Move m) const {
   // Handle the special case of a pawn move
   if (type_of(pc) == PAWN)
   {
-      // We have already handled promotion moves, so destination
-      // cannot be on the 8th/1st rank.
-      if (rank_of(to) == relative_rank(us, RANK_8))
+      // A pawn move is a promotion if and only if the destination
+      // is on the 8th/1st rank.
+      if ((rank_of(to) == relative_rank(us, RANK_8)) != (type_of(m) == PROMOTION))
           return false;
 
       if (   !(attacks_from<PAWN>(us, from) & pieces(~us) & to) // Not a capture
@@ -753,8 +922,20 @@ bool Position::pseudo_legal(const Move m) const {
                && empty(to)
                && empty(to - pawn_push(us))))
           return false;
+
+      // Pawns promote to the standard pieces and to the gating pieces
+      PieceType pt = promotion_type(m);
+      if (type_of(m) == PROMOTION && pt != QUEEN && pt != ROOK && pt != BISHOP && pt != KNIGHT)
+      {
+          Gate g = WHITE_GATE_1;
+          while (g < GATE_NB && gating_piece(g) != pt)
+              ++g;
+
+          if (g == GATE_NB)
+              return false;
+      }
   }
-  else if (!(attacks_from(us, type_of(pc), from) & to))
+  else if (type_of(m) == PROMOTION || !(attacks_from(us, type_of(pc), from) & to))
       return false;
 
   // Evasions generator already takes care to avoid some kind of illegal moves
@@ -768,10 +949,12 @@ bool Position::pseudo_legal(const Move m) const {
           if (more_than_one(checkers()))
               return false;
 
-          // Our move must be a blocking evasion or a capture of the checking piece
+          // Our move must be a blocking evasion or a capture of the checking
+          // piece. Leaper attacks can not be blocked.
           Square checksq = lsb(checkers());
-          if (  !((between_bb(checksq, square<KING>(us)) | checkers()) & to)
-              || (LeaperAttacks[~us][type_of(piece_on(checksq))][checksq] & square<KING>(us)))
+          Bitboard target = LeaperAttacks[~us][type_of(piece_on(checksq))][checksq] & square<KING>(us)
+                          ? checkers() : between_bb(checksq, square<KING>(us)) | checkers();
+          if (!(target & to))
               return false;
       }
       // In case of king moves under check we have to remove king so as to catch
@@ -863,6 +1046,14 @@ void Position::do_move(Move m, StateInfo& newSt, bool givesCheck) {
   assert(is_ok(m));
   assert(&newSt != st);
 
+  // Ordinary moves that neither leave nor capture on a gate square, which is
+  // every normal move once the gates are empty, take a shorter path.
+  if (type_of(m) == NORMAL && !(gateBB & (SquareBB[from_sq(m)] | to_sq(m))))
+  {
+      do_normal_move(m, newSt, givesCheck);
+      return;
+  }
+
   thisThread->nodes.fetch_add(1, std::memory_order_relaxed);
   Key k = st->key ^ Zobrist::side;
 
@@ -893,6 +1084,7 @@ void Position::do_move(Move m, StateInfo& newSt, bool givesCheck) {
           set_gating_type(LEOPARD);
           st->removedGatingType = gating_type(m);
       }
+      set_piece_types();
       break;
   case PUT_GATING_PIECE:
       assert(gating_type(m) == gatingPieces[setupCount[us] + 1]);
@@ -1073,6 +1265,109 @@ void Position::do_move(Move m, StateInfo& newSt, bool givesCheck) {
 }
 
 
+/// Position::do_normal_move() is do_move() for a NORMAL move that touches no
+/// gate square: no gating, castling, en passant or promotion to handle.
+
+void Position::do_normal_move(Move m, StateInfo& newSt, bool givesCheck) {
+
+  thisThread->nodes.fetch_add(1, std::memory_order_relaxed);
+  Key k = st->key ^ Zobrist::side;
+
+  std::memcpy(&newSt, st, offsetof(StateInfo, key));
+  newSt.previous = st;
+  st = &newSt;
+
+  ++gamePly;
+  ++st->rule50;
+  ++st->pliesFromNull;
+
+  Color us = sideToMove;
+  Color them = ~us;
+  Square from = from_sq(m);
+  Square to = to_sq(m);
+  Piece pc = piece_on(from);
+  Piece captured = piece_on(to);
+
+  assert(color_of(pc) == us);
+  assert(captured == NO_PIECE || color_of(captured) == them);
+  assert(type_of(captured) != KING);
+  assert(!(gateBB & (SquareBB[from] | to)));
+
+  if (captured)
+  {
+      if (type_of(captured) == PAWN)
+          st->pawnKey ^= Zobrist::psq[captured][to];
+      else
+          st->nonPawnMaterial[them] -= PieceValue[MG][captured];
+
+      remove_piece(captured, to);
+      st->capturedGate = NO_GATE;
+
+      k ^= Zobrist::psq[captured][to];
+      st->materialKey ^= Zobrist::psq[captured][pieceCount[captured]];
+      prefetch(thisThread->materialTable[st->materialKey]);
+
+      st->psq -= PSQT::psq[captured][to];
+      st->rule50 = 0;
+  }
+
+  k ^= Zobrist::psq[pc][from] ^ Zobrist::psq[pc][to];
+
+  if (st->epSquare != SQ_NONE)
+  {
+      k ^= Zobrist::enpassant[file_of(st->epSquare)];
+      st->epSquare = SQ_NONE;
+  }
+
+  if (st->castlingRights && (castlingRightsMask[from] | castlingRightsMask[to]))
+  {
+      int cr = castlingRightsMask[from] | castlingRightsMask[to];
+      k ^= Zobrist::castling[st->castlingRights & cr];
+      st->castlingRights &= ~cr;
+  }
+
+  move_piece(pc, from, to);
+
+  if (type_of(pc) == PAWN)
+  {
+      if (   (int(to) ^ int(from)) == 16
+          && (attacks_from<PAWN>(us, to - pawn_push(us)) & pieces(them, PAWN)))
+      {
+          st->epSquare = to - pawn_push(us);
+          k ^= Zobrist::enpassant[file_of(st->epSquare)];
+      }
+
+      st->pawnKey ^= Zobrist::psq[pc][from] ^ Zobrist::psq[pc][to];
+      prefetch2(thisThread->pawnsTable[st->pawnKey]);
+      st->rule50 = 0;
+  }
+
+  st->psq += PSQT::psq[pc][to] - PSQT::psq[pc][from];
+  st->capturedPiece = captured;
+  st->checkersBB = givesCheck ? attackers_to(square<KING>(them)) & pieces(us) : 0;
+  st->key = k;
+
+  sideToMove = them;
+
+  // The blockers of a king can only change when the move touches one of the
+  // lines through it, which most moves do not.
+  Bitboard fromTo = SquareBB[from] | to;
+
+  for (Color c = WHITE; c <= BLACK; ++c)
+      if (pc == make_piece(c, KING) || (PseudoAttacks[c][QUEEN][square<KING>(c)] & fromTo))
+          st->blockersForKing[c] = slider_blockers(pieces(~c), square<KING>(c), st->pinners[~c]);
+      else
+      {
+          st->blockersForKing[c] = st->previous->blockersForKing[c];
+          st->pinners[~c] = st->previous->pinners[~c];
+      }
+
+  set_check_squares(st);
+
+  assert(pos_is_ok());
+}
+
+
 /// Position::undo_move() unmakes a move. When it returns, the position should
 /// be restored to exactly the same state as before the move was made.
 
@@ -1082,6 +1377,24 @@ void Position::undo_move(Move m) {
 
   sideToMove = ~sideToMove;
 
+  // Undo of do_normal_move(): the source square is empty again only if no
+  // piece was gated there, and no gate went with the captured piece.
+  if (   type_of(m) == NORMAL
+      && empty(from_sq(m))
+      && (!st->capturedPiece || st->capturedGate == NO_GATE))
+  {
+      move_piece(piece_on(to_sq(m)), to_sq(m), from_sq(m));
+
+      if (st->capturedPiece)
+          put_piece(st->capturedPiece, to_sq(m));
+
+      --gamePly;
+      st = st->previous;
+
+      assert(pos_is_ok());
+      return;
+  }
+
   Color us = sideToMove;
   switch (type_of(m))
   {
@@ -1092,6 +1405,7 @@ void Position::undo_move(Move m) {
           unset_gating_type();
           set_gating_type(st->removedGatingType);
       }
+      set_piece_types();
       break;
   case PUT_GATING_PIECE:
       assert(gating_type(m) == gatingPieces[setupCount[us]]);
@@ -1218,7 +1532,7 @@ void Position::do_null_move(StateInfo& newSt) {
   assert(!checkers());
   assert(&newSt != st);
 
-  std::memcpy(&newSt, st, sizeof(StateInfo));
+  std::memcpy(&newSt, st, offsetof(StateInfo, checkSquares)); // Recomputed below
   newSt.previous = st;
   st = &newSt;
 
@@ -1329,7 +1643,7 @@ bool Position::see_ge(Move m, Value threshold) const {
 
       // Locate and remove the next least valuable attacker, and add to
       // the bitboard 'attackers' the possibly X-ray attackers behind it.
-      nextVictim = min_attacker<PAWN>(byTypeBB, to, stmAttackers, occupied, attackers);
+      nextVictim = min_attacker(*this, to, stmAttackers, occupied, attackers);
 
       stm = ~stm; // Switch side to move
 
@@ -1444,13 +1758,21 @@ bool Position::has_game_cycle(int ply) const {
           Square s1 = from_sq(move);
           Square s2 = to_sq(move);
 
-          if (!(between_bb(s1, s2) & pieces()))
-          {
-              // In the cuckoo table, both moves Rc1c5 and Rc5c1 are stored in the same
-              // location. We select the legal one by reversing the move variable if necessary.
-              if (empty(s1))
-                  move = make_move(s2, s1);
+          // In the cuckoo table, both moves Rc1c5 and Rc5c1 are stored in the same
+          // location. We select the legal one by reversing the move if necessary.
+          if (empty(s1))
+              std::swap(s1, s2);
+
+          Piece pc = piece_on(s1);
+
+          // A key matching by collision may leave both squares empty
+          if (pc == NO_PIECE)
+              continue;
 
+          // Leaps can not be blocked, slides need a free path
+          if (   (LeaperAttacks[color_of(pc)][type_of(pc)][s1] & s2)
+              || !(between_bb(s1, s2) & pieces()))
+          {
               if (ply > i)
                   return true;
 
@@ -1575,33 +1897,3 @@ bool Position::pos_is_ok() const {
 
   return true;
 }
-
-// Custom piece management functions
-void Position::add_custom_piece(Color c, const std::string& name, const std::string& betzaNotation) {
-    customPieceNames[c].push_back(name);
-    customPieceBetza[c].push_back(betzaNotation);
-    
-    // Add to Betza manager
-    Betza::betzaManager.addPiece(name, betzaNotation);
-}
-
-void Position::clear_custom_pieces(Color c) {
-    customPieceNames[c].clear();
-    customPieceBetza[c].clear();
-}
-
-void Position::set_asymmetric_pieces(bool asymmetric) {
-    asymmetricPieces = asymmetric;
-}
-
-bool Position::has_asymmetric_pieces() const {
-    return asymmetricPieces;
-}
-
-const std::vector<std::string>& Position::get_custom_piece_names(Color c) const {
-    return customPieceNames[c];
-}
-
-const std::vector<std::string>& Position::get_custom_piece_betza(Color c) const {
-    return customPieceBetza[c];
-}
@@ -75,6 +75,7 @@ class Thread;
 class Position {
 public:
   static void init();
+  static void init_cuckoo();
 
   Position() = default;
   Position(const Position&) = delete;
@@ -83,6 +84,7 @@ public:
   // FEN string input/output
   Position& set(const std::string& fenStr, bool isChess960, StateInfo* si, Thread* th);
   Position& set(const std::string& code, Color c, StateInfo* si);
+  Position& set(const Position& pos, Thread* th);
   const std::string fen() const;
 
   // Position representation
@@ -100,6 +102,7 @@ public:
   template<PieceType Pt> const Square* squares(Color c) const;
   const Square* squares(Color c, PieceType pt) const;
   template<PieceType Pt> Square square(Color c) const;
+  const PieceType* piece_types() const;
   Bitboard gates() const;
   PieceType gating_piece(Gate gate) const;
   PieceType gating_piece(Square s) const;
@@ -114,6 +117,7 @@ public:
   // Checking
   Bitboard checkers() const;
   Bitboard blockers_for_king(Color c) const;
+  Bitboard pinners(Color c) const;
   Bitboard check_squares(PieceType pt) const;
 
   // Attacks to/from a given square
@@ -178,6 +182,8 @@ private:
   void set_castling_right(Color c, Square rfrom);
   void set_state(StateInfo* si) const;
   void set_check_info(StateInfo* si) const;
+  void set_check_squares(StateInfo* si) const;
+  void set_piece_types();
 
   // Other helpers
   void set_gating_type(PieceType pt);
@@ -193,43 +199,35 @@ private:
   void put_piece(Piece pc, Square s);
   void remove_piece(Piece pc, Square s);
   void move_piece(Piece pc, Square from, Square to);
+  void do_normal_move(Move m, StateInfo& newSt, bool givesCheck);
   template<bool Do>
   void do_castling(Color us, Square from, Square& to, Square& rfrom, Square& rto, Key& k);
-  
-  // Custom piece management
-  void add_custom_piece(Color c, const std::string& name, const std::string& betzaNotation);
-  void clear_custom_pieces(Color c);
-  void set_asymmetric_pieces(bool asymmetric);
-  bool has_asymmetric_pieces() const;
-  const std::vector<std::string>& get_custom_piece_names(Color c) const;
-  const std::vector<std::string>& get_custom_piece_betza(Color c) const;
-
-  // Data members
+
+  // Data members, the ones used at every node first
   Piece board[SQUARE_NB];
-  Gate gateBoard[SQUARE_NB];
-  PieceType gatingPieces[GATE_NB];
-  Square gatingSquares[COLOR_NB][GATE_NB];
-  Bitboard byTypeBB[PIECE_TYPE_NB];
   Bitboard byColorBB[COLOR_NB];
+  Bitboard byTypeBB[PIECE_TYPE_NB];
+  Bitboard byComponentBB[COMPONENT_NB]; // Valid for one ComponentGeneration
+  StateInfo* st;
+  Thread* thisThread;
+  int gamePly;
+  Color sideToMove;
+  bool chess960;
   Bitboard gateBB;
-  int pieceCount[PIECE_NB];
-  Gate gateCount;
-  Gate setupCount[COLOR_NB];
+  PieceType pieceTypes[PIECE_TYPE_NB];
+  // Indexed by Piece, not by the dense PieceIndex: custom pieces can take it
+  // up to PIECE_NB - 1 at runtime, and a Position is copied as a whole.
+  uint8_t pieceCount[PIECE_NB];
+  uint8_t index[SQUARE_NB];
   Square pieceList[PIECE_NB][16];
-  int index[SQUARE_NB];
   int castlingRightsMask[SQUARE_NB];
   Square castlingRookSquare[CASTLING_RIGHT_NB];
   Bitboard castlingPath[CASTLING_RIGHT_NB];
-  int gamePly;
-  Color sideToMove;
-  Thread* thisThread;
-  StateInfo* st;
-  bool chess960;
-  
-  // Dynamic piece management
-  std::vector<std::string> customPieceNames[COLOR_NB];
-  std::vector<std::string> customPieceBetza[COLOR_NB];
-  bool asymmetricPieces = false;
+  Gate gateCount;
+  Gate setupCount[COLOR_NB];
+  Gate gateBoard[SQUARE_NB];
+  PieceType gatingPieces[GATE_NB];
+  Square gatingSquares[COLOR_NB][GATE_NB];
 };
 
 extern std::ostream& operator<<(std::ostream& os, const Position& pos);
@@ -297,6 +295,10 @@ template<PieceType Pt> inline Square Position::square(Color c) const {
   return pieceList[make_piece(c, Pt)][0];
 }
 
+inline const PieceType* Position::piece_types() const {
+  return pieceTypes;
+}
+
 inline Bitboard Position::gates() const {
   return gateBB;
 }
@@ -339,7 +341,7 @@ inline Square Position::castling_rook_square(CastlingRight cr) const {
 
 template<PieceType Pt>
 inline Bitboard Position::attacks_from(Color c, Square s) const {
-  return attacks_bb(c, Pt, s, byTypeBB[ALL_PIECES]);
+  return attacks_bb<Pt>(c, s, byTypeBB[ALL_PIECES]);
 }
 
 inline Bitboard Position::attacks_from(Color c, PieceType pt, Square s) const {
@@ -358,6 +360,10 @@ inline Bitboard Position::blockers_for_king(Color c) const {
   return st->blockersForKing[c];
 }
 
+inline Bitboard Position::pinners(Color c) const {
+  return st->pinners[c];
+}
+
 inline Bitboard Position::check_squares(PieceType pt) const {
   return st->checkSquares[pt];
 }
@@ -514,6 +520,8 @@ inline void Position::put_piece(Piece pc, Square s) {
   byTypeBB[ALL_PIECES] |= s;
   byTypeBB[type_of(pc)] |= s;
   byColorBB[color_of(pc)] |= s;
+  for (Bitboard c = PieceComponents[type_of(pc)]; c; )
+      byComponentBB[pop_lsb(&c)] |= s;
   index[s] = pieceCount[pc]++;
   pieceList[pc][index[s]] = s;
   pieceCount[make_piece(color_of(pc), ALL_PIECES)]++;
@@ -528,6 +536,8 @@ inline void Position::remove_piece(Piece pc, Square s) {
   byTypeBB[ALL_PIECES] ^= s;
   byTypeBB[type_of(pc)] ^= s;
   byColorBB[color_of(pc)] ^= s;
+  for (Bitboard c = PieceComponents[type_of(pc)]; c; )
+      byComponentBB[pop_lsb(&c)] ^= s;
   /* board[s] = NO_PIECE;  Not needed, overwritten by the capturing one */
   Square lastSquare = pieceList[pc][--pieceCount[pc]];
   index[lastSquare] = index[s];
@@ -544,6 +554,8 @@ inline void Position::move_piece(Piece pc, Square from, Square to) {
   byTypeBB[ALL_PIECES] ^= fromTo;
   byTypeBB[type_of(pc)] ^= fromTo;
   byColorBB[color_of(pc)] ^= fromTo;
+  for (Bitboard c = PieceComponents[type_of(pc)]; c; )
+      byComponentBB[pop_lsb(&c)] ^= fromTo;
   board[from] = NO_PIECE;
   board[to] = pc;
   index[to] = index[from];
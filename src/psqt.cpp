@@ -19,6 +19,7 @@
 */
 
 #include <algorithm>
+#include <iterator>
 
 #include "types.h"
 
@@ -54,6 +55,10 @@ Value PieceValue[PHASE_NB][PIECE_NB] = {
   }
 };
 
+uint8_t PieceIndex[PIECE_NB];
+int PieceIndexNb;
+PieceType SeeOrder[PIECE_TYPE_NB];
+
 namespace PSQT {
 
 #define S(mg, eg) make_score(mg, eg)
@@ -233,9 +238,19 @@ Score psq_gate[PIECE_NB][FILE_NB];
 // init() initializes piece-square tables: the white halves of the tables are
 // copied from Bonus[] adding the piece value, then the black halves of the
 // tables are initialized by flipping and changing the sign of the white scores.
+// Custom piece types have no bonus and are refreshed when they are registered,
+// which also renumbers the dense PieceIndex of the pieces in play and sorts
+// them by value in SeeOrder.
 void init() {
 
-  for (PieceType pt = PAWN; pt <= KING; ++pt)
+  std::fill(std::begin(PieceIndex), std::end(PieceIndex), 0);
+  PieceIndexNb = 1;
+
+  for (Color c = WHITE; c <= BLACK; ++c)
+      for (PieceType pt = PAWN; pt < PieceTypeEnd; ++pt)
+          PieceIndex[make_piece(c, pt)] = uint8_t(PieceIndexNb++);
+
+  for (PieceType pt = PAWN; pt < PIECE_TYPE_NB; ++pt)
   {
       Piece pc = make_piece(WHITE, pt);
 
@@ -256,6 +271,16 @@ void init() {
           psq_gate[~pc][~f] = -psq_gate[pc][f];
       }
   }
+
+  PieceType* end = SeeOrder;
+  for (PieceType pt = PAWN; pt < PieceTypeEnd; ++pt)
+      if (pt != KING)
+          *end++ = pt;
+
+  std::stable_sort(SeeOrder, end, [](PieceType a, PieceType b) {
+      return PieceValue[MG][a] < PieceValue[MG][b];
+  });
+  *end = KING;
 }
 
 } // namespace PSQT
@@ -26,6 +26,7 @@
 #include <sstream>
 
 #include "evaluate.h"
+#include "fairytb.h"
 #include "misc.h"
 #include "movegen.h"
 #include "movepick.h"
@@ -45,6 +46,7 @@ namespace Search {
 namespace Tablebases {
 
   int Cardinality;
+  int FairyCardinality;
   bool RootInTB;
   bool UseRule50;
   Depth ProbeDepth;
@@ -113,30 +115,81 @@ namespace {
     return  pos.gives_check(move);
   }
 
+  // PerftEntry is an entry of the perft hash table, shared by all threads. The
+  // depth is in the low byte of data and the count above it. The key is stored
+  // xored with data, so that an entry torn by concurrent writes fails the key
+  // check instead of returning a wrong count.
+  struct PerftEntry {
+    Key key;
+    uint64_t data;
+  };
+
+  constexpr size_t PerftHashMB = 256;
+
+  std::vector<PerftEntry> PerftTable;
+  std::vector<uint64_t> PerftCounts;
+  std::atomic<size_t> PerftNextMove;
+
   // perft() is our utility to verify move generation. All the leaf nodes up
   // to the given depth are generated and counted, and the sum is returned.
-  template<bool Root>
+  // The last ply is counted in bulk, and the counts of subtrees three or more
+  // plies deep are looked up in and stored to PerftTable.
   uint64_t perft(Position& pos, Depth depth) {
 
+    if (depth == ONE_PLY)
+        return MoveList<LEGAL>(pos).size();
+
+    PerftEntry* tte = nullptr;
+
+    if (depth >= 3 * ONE_PLY)
+    {
+        tte = &PerftTable[pos.key() & (PerftTable.size() - 1)];
+        uint64_t data = tte->data;
+
+        if ((tte->key ^ data) == pos.key() && Depth(data & 0xFF) == depth)
+            return data >> 8;
+    }
+
     StateInfo st;
-    uint64_t cnt, nodes = 0;
-    const bool leaf = (depth == 2 * ONE_PLY);
+    uint64_t nodes = 0;
 
     for (const auto& m : MoveList<LEGAL>(pos))
     {
-        if (Root && depth <= ONE_PLY)
-            cnt = 1, nodes++;
+        pos.do_move(m, st);
+        nodes += perft(pos, depth - ONE_PLY);
+        pos.undo_move(m);
+    }
+
+    if (tte)
+    {
+        uint64_t data = nodes << 8 | uint64_t(depth);
+        tte->key = pos.key() ^ data;
+        tte->data = data;
+    }
+    return nodes;
+  }
+
+  // perft_root_moves() makes the given thread count the subtrees of the root
+  // moves no other thread has taken yet, until all of them are counted.
+  void perft_root_moves(Thread* th) {
+
+    StateInfo st;
+    Position& pos = th->rootPos;
+    Depth depth = Limits.perft * ONE_PLY;
+
+    for (size_t i; (i = PerftNextMove++) < th->rootMoves.size(); )
+    {
+        Move m = th->rootMoves[i].pv[0];
+
+        if (depth <= ONE_PLY)
+            PerftCounts[i] = 1;
         else
         {
             pos.do_move(m, st);
-            cnt = leaf ? MoveList<LEGAL>(pos).size() : perft<false>(pos, depth - ONE_PLY);
-            nodes += cnt;
+            PerftCounts[i] = perft(pos, depth - ONE_PLY);
             pos.undo_move(m);
         }
-        if (Root)
-            sync_cout << UCI::move(m, pos) << ": " << cnt << sync_endl;
     }
-    return nodes;
   }
 
 } // namespace
@@ -185,10 +238,48 @@ void Search::clear() {
 
 void MainThread::search() {
 
+  // Perft splits the root moves among all the threads, which share a perft
+  // hash table as big as the transposition table, up to PerftHashMB. It is
+  // allocated on top of the TT, which may be shared with other processes.
   if (Limits.perft)
   {
-      nodes = perft<true>(rootPos, Limits.perft * ONE_PLY);
-      sync_cout << "\nNodes searched: " << nodes << "\n" << sync_endl;
+      size_t entries = std::min(size_t(Options["Hash"]), PerftHashMB) * 1024 * 1024 / sizeof(PerftEntry);
+      size_t size = 1;
+      while (size * 2 <= entries)
+          size *= 2;
+
+      PerftTable.assign(size, PerftEntry());
+      PerftCounts.assign(rootMoves.size(), 0);
+      PerftNextMove = 0;
+
+      for (Thread* th : Threads)
+          if (th != this)
+              th->start_searching();
+
+      perft_root_moves(this);
+
+      for (Thread* th : Threads)
+          if (th != this)
+              th->wait_for_search_finished();
+
+      uint64_t total = 0;
+      for (size_t i = 0; i < rootMoves.size(); ++i)
+      {
+          sync_cout << UCI::move(rootMoves[i].pv[0], rootPos) << ": " << PerftCounts[i] << sync_endl;
+          total += PerftCounts[i];
+      }
+
+      // Report the leaves as the nodes searched, not the moves made by the threads
+      for (Thread* th : Threads)
+          th->nodes = 0;
+      nodes = total;
+      std::vector<PerftEntry>().swap(PerftTable);
+
+      TimePoint elapsed = now() - Limits.startTime + 1; // Ensure positivity to avoid a 'divide by zero'
+
+      sync_cout << "info nodes " << total << " time " << elapsed
+                << " nps " << total * 1000 / elapsed << sync_endl;
+      sync_cout << "\nNodes searched: " << total << "\n" << sync_endl;
       return;
   }
 
@@ -196,6 +287,14 @@ void MainThread::search() {
   Time.init(Limits, us, rootPos.game_ply());
   TT.new_search();
 
+  // The timer enforces time limits, except when the time is counted in nodes
+  // (npmsec), which check_time() polls.
+  if (!Limits.npmsec && (Limits.use_time_management() || Limits.movetime))
+  {
+      TimePoint deadline = Limits.use_time_management() ? Time.maximum() - 9 : Limits.movetime;
+      Threads.start_timer(Limits.movetime ? std::min(deadline, TimePoint(Limits.movetime)) : deadline);
+  }
+
   if (rootMoves.empty())
   {
       rootMoves.emplace_back(MOVE_NONE);
@@ -224,13 +323,12 @@ void MainThread::search() {
   // GUI sends a "stop" or "ponderhit" command. We therefore simply wait here
   // until the GUI sends one of those commands (which also raises Threads.stop).
   Threads.stopOnPonderhit = true;
+  Threads.wait_for_stop();
 
-  while (!Threads.stop && (Threads.ponder || Limits.infinite))
-  {} // Busy wait for a stop or a ponder reset
-
-  // Stop the threads if not already stopped (also raise the stop if
-  // "ponderhit" just reset Threads.ponder).
-  Threads.stop = true;
+  // Stop the threads and the timer if not already stopped (also raise the
+  // stop if "ponderhit" just reset Threads.ponder).
+  Threads.stop_search();
+  Threads.join_timer();
 
   // Wait until all threads have finished
   for (Thread* th : Threads)
@@ -289,6 +387,13 @@ void MainThread::search() {
 
 void Thread::search() {
 
+  // Helper threads of a perft only count root moves, see MainThread::search()
+  if (Limits.perft)
+  {
+      perft_root_moves(this);
+      return;
+  }
+
   Stack stack[MAX_PLY+7], *ss = stack+4; // To reference from (ss-4) to (ss+2)
   Value bestValue, alpha, beta, delta;
   Move  lastBestMove = MOVE_NONE;
@@ -650,48 +755,77 @@ namespace {
     }
 
     // Step 5. Tablebases probe
-    if (!rootNode && TB::Cardinality)
+    if (!rootNode && (TB::Cardinality || TB::FairyCardinality))
     {
         int piecesCount = pos.count<ALL_PIECES>();
-
-        if (    piecesCount <= TB::Cardinality
-            && (piecesCount <  TB::Cardinality || depth >= TB::ProbeDepth)
-            &&  pos.rule50_count() == 0
-            && !pos.can_castle(ANY_CASTLING))
+        TB::ProbeState err = TB::ProbeState::FAIL;
+        TB::WDLScore wdl = TB::WDLDraw;
+
+        bool syzygy =   piecesCount <= TB::Cardinality
+                     && (piecesCount <  TB::Cardinality || depth >= TB::ProbeDepth)
+                     &&  pos.rule50_count() == 0
+                     && !pos.can_castle(ANY_CASTLING)
+                     && !pos.gates();
+
+        // The endgames with fairy pieces are in the fairy tablebases
+        bool fairy =    piecesCount <= TB::FairyCardinality
+                     &&  pos.rule50_count() == 0
+                     && !pos.can_castle(ANY_CASTLING)
+                     && !pos.gates();
+
+        if (syzygy || fairy)
         {
-            TB::ProbeState err;
-            TB::WDLScore wdl = Tablebases::probe_wdl(pos, &err);
+            TB::CacheEntry* e = thisThread->tbCache[pos.key()];
 
-            if (err != TB::ProbeState::FAIL)
+            if (e->key == pos.key())
+            {
+                thisThread->tbCacheHits.fetch_add(1, std::memory_order_relaxed);
+                wdl = e->wdl, err = TB::ProbeState::OK;
+            }
+            else
             {
-                thisThread->tbHits.fetch_add(1, std::memory_order_relaxed);
+                thisThread->tbCacheMisses.fetch_add(1, std::memory_order_relaxed);
 
-                int drawScore = TB::UseRule50 ? 1 : 0;
+                if (syzygy)
+                    wdl = Tablebases::probe_wdl(pos, &err);
 
-                value =  wdl < -drawScore ? -VALUE_MATE + MAX_PLY + ss->ply + 1
-                       : wdl >  drawScore ?  VALUE_MATE - MAX_PLY - ss->ply - 1
-                                          :  VALUE_DRAW + 2 * wdl * drawScore;
+                if (err == TB::ProbeState::FAIL && fairy)
+                    wdl = FairyTablebases::probe_wdl(pos, &err);
 
-                Bound b =  wdl < -drawScore ? BOUND_UPPER
-                         : wdl >  drawScore ? BOUND_LOWER : BOUND_EXACT;
+                if (err != TB::ProbeState::FAIL)
+                    e->key = pos.key(), e->wdl = wdl;
+            }
+        }
 
-                if (    b == BOUND_EXACT
-                    || (b == BOUND_LOWER ? value >= beta : value <= alpha))
-                {
-                    tte->save(posKey, value_to_tt(value, ss->ply), b,
-                              std::min(DEPTH_MAX - ONE_PLY, depth + 6 * ONE_PLY),
-                              MOVE_NONE, VALUE_NONE, TT.generation());
+        if (err != TB::ProbeState::FAIL)
+        {
+            thisThread->tbHits.fetch_add(1, std::memory_order_relaxed);
 
-                    return value;
-                }
-
-                if (PvNode)
-                {
-                    if (b == BOUND_LOWER)
-                        bestValue = value, alpha = std::max(alpha, bestValue);
-                    else
-                        maxValue = value;
-                }
+            int drawScore = TB::UseRule50 ? 1 : 0;
+
+            value =  wdl < -drawScore ? -VALUE_MATE + MAX_PLY + ss->ply + 1
+                   : wdl >  drawScore ?  VALUE_MATE - MAX_PLY - ss->ply - 1
+                                      :  VALUE_DRAW + 2 * wdl * drawScore;
+
+            Bound b =  wdl < -drawScore ? BOUND_UPPER
+                     : wdl >  drawScore ? BOUND_LOWER : BOUND_EXACT;
+
+            if (    b == BOUND_EXACT
+                || (b == BOUND_LOWER ? value >= beta : value <= alpha))
+            {
+                tte->save(posKey, value_to_tt(value, ss->ply), b,
+                          std::min(DEPTH_MAX - ONE_PLY, depth + 6 * ONE_PLY),
+                          MOVE_NONE, VALUE_NONE, TT.generation());
+
+                return value;
+            }
+
+            if (PvNode)
+            {
+                if (b == BOUND_LOWER)
+                    bestValue = value, alpha = std::max(alpha, bestValue);
+                else
+                    maxValue = value;
             }
         }
     }
@@ -707,7 +841,7 @@ namespace {
     {
         // Never assume anything on values stored in TT
         if ((ss->staticEval = eval = tte->eval()) == VALUE_NONE)
-            eval = ss->staticEval = evaluate(pos);
+            eval = ss->staticEval = thisThread->evalCache.evaluate(pos);
 
         // Can ttValue be used as a better position evaluation?
         if (    ttValue != VALUE_NONE
@@ -717,7 +851,7 @@ namespace {
     else
     {
         ss->staticEval = eval =
-        (ss-1)->currentMove != MOVE_NULL ? evaluate(pos)
+        (ss-1)->currentMove != MOVE_NULL ? thisThread->evalCache.evaluate(pos)
                                          : -(ss-1)->staticEval + 2 * Eval::Tempo;
 
         tte->save(posKey, VALUE_NONE, BOUND_NONE, DEPTH_NONE, MOVE_NONE,
@@ -968,6 +1102,7 @@ moves_loop: // When in check, search starts from here
 
       // Speculative prefetch as early as possible
       prefetch(TT.first_entry(pos.key_after(move)));
+      thisThread->evalCache.prefetch(pos.key_after(move));
 
       // Check for legality just before making the move
       if (!rootNode && !pos.legal(move))
@@ -1266,7 +1401,7 @@ moves_loop: // When in check, search starts from here
         {
             // Never assume anything on values stored in TT
             if ((ss->staticEval = bestValue = tte->eval()) == VALUE_NONE)
-                ss->staticEval = bestValue = evaluate(pos);
+                ss->staticEval = bestValue = pos.this_thread()->evalCache.evaluate(pos);
 
             // Can ttValue be used as a better position evaluation?
             if (   ttValue != VALUE_NONE
@@ -1275,7 +1410,7 @@ moves_loop: // When in check, search starts from here
         }
         else
             ss->staticEval = bestValue =
-            (ss-1)->currentMove != MOVE_NULL ? evaluate(pos)
+            (ss-1)->currentMove != MOVE_NULL ? pos.this_thread()->evalCache.evaluate(pos)
                                              : -(ss-1)->staticEval + 2 * Eval::Tempo;
 
         // Stand pat. Return immediately if static value is at least beta
@@ -1347,6 +1482,7 @@ moves_loop: // When in check, search starts from here
 
       // Speculative prefetch as early as possible
       prefetch(TT.first_entry(pos.key_after(move)));
+      pos.this_thread()->evalCache.prefetch(pos.key_after(move));
 
       // Check for legality just before making the move
       if (!pos.legal(move))
@@ -1537,7 +1673,7 @@ moves_loop: // When in check, search starts from here
 } // namespace
 
 /// MainThread::check_time() is used to print debug info and, more importantly,
-/// to detect when we are out of available time and thus stop the search.
+/// to detect when we have searched the allowed nodes and thus stop the search.
 
 void MainThread::check_time() {
 
@@ -1549,8 +1685,7 @@ void MainThread::check_time() {
 
   static TimePoint lastInfoTime = now();
 
-  TimePoint elapsed = Time.elapsed();
-  TimePoint tick = Limits.startTime + elapsed;
+  TimePoint tick = now();
 
   if (tick - lastInfoTime >= 1000)
   {
@@ -1562,8 +1697,11 @@ void MainThread::check_time() {
   if (Threads.ponder)
       return;
 
-  if (   (Limits.use_time_management() && elapsed > Time.maximum() - 10)
-      || (Limits.movetime && elapsed >= Limits.movetime)
+  // Time limits are enforced by the timer, unless the time is counted in nodes
+  TimePoint elapsed = Limits.npmsec ? Time.elapsed() : 0;
+
+  if (   (Limits.npmsec && Limits.use_time_management() && elapsed > Time.maximum() - 10)
+      || (Limits.npmsec && Limits.movetime && elapsed >= Limits.movetime)
       || (Limits.nodes && Threads.nodes_searched() >= (uint64_t)Limits.nodes))
       Threads.stop = true;
 }
@@ -1637,6 +1775,11 @@ string UCI::pv(const Position& pos, Depth depth, Value alpha, Value beta) {
       }
   }
 
+  uint64_t cacheHits = Threads.tb_cache_hits(), cacheMisses = Threads.tb_cache_misses();
+
+  if (cacheHits + cacheMisses && ss.rdbuf()->in_avail() && !(Options["Protocol"] == "xboard"))
+      ss << "\ninfo string tbcache hits " << cacheHits << " misses " << cacheMisses;
+
   return ss.str();
 }
 
@@ -1676,6 +1819,7 @@ void Tablebases::rank_root_moves(Position& pos, Search::RootMoves& rootMoves) {
     UseRule50 = bool(Options["Syzygy50MoveRule"]);
     ProbeDepth = int(Options["SyzygyProbeDepth"]) * ONE_PLY;
     Cardinality = int(Options["SyzygyProbeLimit"]);
+    FairyCardinality = FairyTablebases::MaxCardinality;
     bool dtz_available = true;
 
     // Tables with fewer pieces than SyzygyProbeLimit are searched with
@@ -1686,7 +1830,9 @@ void Tablebases::rank_root_moves(Position& pos, Search::RootMoves& rootMoves) {
         ProbeDepth = DEPTH_ZERO;
     }
 
-    if (Cardinality >= popcount(pos.pieces()) && !pos.can_castle(ANY_CASTLING))
+    if (   Cardinality >= popcount(pos.pieces())
+        && !pos.can_castle(ANY_CASTLING)
+        && !pos.gates())
     {
         // Rank moves using DTZ tables
         RootInTB = root_probe(pos, rootMoves);
@@ -1699,6 +1845,15 @@ void Tablebases::rank_root_moves(Position& pos, Search::RootMoves& rootMoves) {
         }
     }
 
+    // The fairy tablebases rank the moves with DTZ only, so the search does
+    // not probe them when they do.
+    if (   !RootInTB
+        &&  FairyCardinality >= popcount(pos.pieces())
+        && !pos.can_castle(ANY_CASTLING)
+        && !pos.gates()
+        &&  FairyTablebases::root_probe(pos, rootMoves))
+        RootInTB = true, FairyCardinality = 0;
+
     if (RootInTB)
     {
         // Sort moves according to TB rank
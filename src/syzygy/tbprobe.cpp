@@ -26,6 +26,7 @@
 #include <iostream>
 #include <list>
 #include <sstream>
+#include <thread>
 #include <type_traits>
 
 #include "../bitboard.h"
@@ -67,7 +68,10 @@ inline WDLScore operator-(WDLScore d) { return WDLScore(-int(d)); }
 inline Square operator^=(Square& s, int i) { return s = Square(int(s) ^ i); }
 inline Square operator^(Square s, int i) { return Square(int(s) ^ i); }
 
-const std::string PieceToChar = " PNBRQK  pnbrqk";
+// TB files store a piece in a nibble: PAWN..KING as 1..6, plus 8 if black
+inline Piece tb_piece(int code) {
+    return make_piece(Color(code >> 3), (code & 7) == 6 ? KING : PieceType(code & 7));
+}
 
 int MapPawns[SQUARE_NB];
 int MapB1H1H7[SQUARE_NB];
@@ -166,8 +170,9 @@ static_assert(sizeof(LR) == 3, "LR tree entry must be 3 bytes");
 //  TBTables: has ownership of TBTable objects, keeping a list and a hash
 
 // class TBFile memory maps/unmaps the single .rtbw and .rtbz files. Files are
-// memory mapped for best performance. Files are mapped at first access: at init
-// time only existence of the file is checked.
+// memory mapped for best performance. Files are mapped at first access, or by
+// the warm-up thread if "SyzygyWarmup" is set: at init time only existence of
+// the file is checked.
 class TBFile : public std::ifstream {
 
     std::string fname;
@@ -312,6 +317,7 @@ struct TBTable {
     static constexpr int Sides = Type == WDL ? 2 : 1;
 
     std::atomic_bool ready;
+    std::string name; // File name without extension, like "KRvK"
     void* baseAddress;
     uint8_t* map;
     uint64_t mapping;
@@ -343,6 +349,7 @@ TBTable<WDL>::TBTable(const std::string& code) : TBTable() {
     StateInfo st;
     Position pos;
 
+    name = code;
     key = pos.set(code, WHITE, &st).material_key();
     pieceCount = pos.count<ALL_PIECES>();
     hasPawns = pos.pieces(PAWN);
@@ -369,6 +376,7 @@ template<>
 TBTable<DTZ>::TBTable(const TBTable<WDL>& wdl) : TBTable() {
 
     // Use the corresponding WDL table to avoid recalculating all from scratch
+    name = wdl.name;
     key = wdl.key;
     key2 = wdl.key2;
     pieceCount = wdl.pieceCount;
@@ -421,10 +429,34 @@ public:
     }
     size_t size() const { return wdlTable.size(); }
     void add(const std::vector<PieceType>& pieces);
+    void warm_up(const std::atomic_bool& stop);
 };
 
 TBTables TBTables;
 
+// struct WarmUp owns the background thread that maps the tables found at init
+// time when "SyzygyWarmup" is set. The thread is stopped before the tables are
+// cleared, by the next Tablebases::init() call or at exit.
+struct WarmUp {
+
+    std::thread thread;
+    std::atomic_bool stop;
+
+    WarmUp() : stop(false) {}
+   ~WarmUp() { cancel(); }
+
+    void start() { thread = std::thread([this]() { TBTables.warm_up(stop); }); }
+
+    void cancel() {
+        stop = true;
+        if (thread.joinable())
+            thread.join();
+        stop = false;
+    }
+};
+
+WarmUp WarmUp;
+
 // If the corresponding file exists two new objects TBTable<WDL> and TBTable<DTZ>
 // are created and added to the lists and hash table. Called at init time.
 void TBTables::add(const std::vector<PieceType>& pieces) {
@@ -644,7 +676,7 @@ Ret do_probe_table(const Position& pos, T* entry, WDLScore wdl, ProbeState* resu
     // flip the squares before to lookup.
     bool blackStronger = (pos.material_key() != entry->key);
 
-    int flipColor   = (symmetricBlackToMove || blackStronger) * 8;
+    int flipColor   = (symmetricBlackToMove || blackStronger) << PIECE_TYPE_BITS;
     int flipSquares = (symmetricBlackToMove || blackStronger) * 070;
     int stm         = (symmetricBlackToMove || blackStronger) ^ pos.side_to_move();
 
@@ -1036,7 +1068,7 @@ void set(T& e, uint8_t* data) {
 
         for (int k = 0; k < e.pieceCount; ++k, ++data)
             for (int i = 0; i < sides; i++)
-                e.get(i, f)->pieces[k] = Piece(i ? *data >>  4 : *data & 0xF);
+                e.get(i, f)->pieces[k] = tb_piece(i ? *data >>  4 : *data & 0xF);
 
         for (int i = 0; i < sides; ++i)
             set_groups(e, e.get(i, f), order[i], f);
@@ -1070,12 +1102,38 @@ void set(T& e, uint8_t* data) {
         }
 }
 
+// Check that the pieces read from the file are the ones in its name, so that a
+// wrong file or a piece numbering mismatch leaves the table unused instead of
+// returning wrong scores.
+template<typename T>
+bool pieces_match(T& e) {
+
+    const int sides = T::Sides == 2 && (e.key != e.key2) ? 2 : 1;
+    const File maxFile = e.hasPawns ? FILE_D : FILE_A;
+
+    for (File f = FILE_A; f <= maxFile; ++f)
+        for (int i = 0; i < sides; i++) {
+            std::string w, b;
+            for (PieceType pt = KING; pt >= PAWN; --pt)
+                for (int k = 0; k < e.pieceCount; ++k) {
+                    Piece pc = e.get(i, f)->pieces[k];
+                    if (type_of(pc) == pt)
+                        (color_of(pc) == WHITE ? w : b) += PieceToChar[pt];
+                }
+
+            if (w + 'v' + b != e.name)
+                return false;
+        }
+
+    return true;
+}
+
 // If the TB file corresponding to the given position is already memory mapped
 // then return its base address, otherwise try to memory map and init it. Called
 // at every probe, memory map and init only at first access. Function is thread
 // safe and can be called concurrently.
 template<TBType Type>
-void* mapped(TBTable<Type>& e, const Position& pos) {
+void* mapped(TBTable<Type>& e, const std::string& fname) {
 
     static Mutex mutex;
 
@@ -1089,23 +1147,105 @@ void* mapped(TBTable<Type>& e, const Position& pos) {
     if (e.ready.load(std::memory_order_relaxed)) // Recheck under lock
         return e.baseAddress;
 
+    uint8_t* data = TBFile(fname).map(&e.baseAddress, &e.mapping, Type);
+
+    if (data)
+        set(e, data);
+
+    if (data && !pieces_match(e)) {
+        std::cerr << "Unexpected pieces in file " << fname << std::endl;
+        TBFile::unmap(e.baseAddress, e.mapping);
+        e.baseAddress = nullptr;
+    }
+
+    e.ready.store(true, std::memory_order_release);
+    return e.baseAddress;
+}
+
+template<TBType Type>
+void* mapped(TBTable<Type>& e, const Position& pos) {
+
+    if (e.ready.load(std::memory_order_acquire))
+        return e.baseAddress;
+
     // Pieces strings in decreasing order for each color, like ("KPP","KR")
-    std::string fname, w, b;
+    std::string w, b;
     for (PieceType pt = KING; pt >= PAWN; --pt) {
         w += std::string(popcount(pos.pieces(WHITE, pt)), PieceToChar[pt]);
         b += std::string(popcount(pos.pieces(BLACK, pt)), PieceToChar[pt]);
     }
 
-    fname =  (e.key == pos.material_key() ? w + 'v' + b : b + 'v' + w)
-           + (Type == WDL ? ".rtbw" : ".rtbz");
+    return mapped(e,  (e.key == pos.material_key() ? w + 'v' + b : b + 'v' + w)
+                    + (Type == WDL ? ".rtbw" : ".rtbz"));
+}
 
-    uint8_t* data = TBFile(fname).map(&e.baseAddress, &e.mapping, Type);
+volatile uint8_t PrefetchSink; // Keeps the page touching reads below
 
-    if (data)
-        set(e, data);
+// Ask the OS to read ahead a region of a memory mapped file, then fault its
+// pages in, so that they are resident when a probe first reads them.
+void prefetch(const void* addr, size_t size) {
 
-    e.ready.store(true, std::memory_order_release);
-    return e.baseAddress;
+    if (!size)
+        return;
+
+#ifndef _WIN32
+    uintptr_t begin = (uintptr_t)addr & ~(uintptr_t(sysconf(_SC_PAGESIZE)) - 1);
+    madvise((void*)begin, (uintptr_t)addr + size - begin, MADV_WILLNEED);
+#endif
+
+    const uint8_t* data = (const uint8_t*)addr;
+    uint8_t sum = data[size - 1];
+
+    for (size_t i = 0; i < size; i += 4096)
+        sum += data[i];
+
+    PrefetchSink = sum;
+}
+
+// Map the file of a table found at init time and read ahead its sparse index
+// and block length regions, which every probe goes through. Called by the
+// warm-up thread, it takes the same path as a probe would.
+template<TBType Type>
+bool warm_up(TBTable<Type>& e) {
+
+    if (!mapped(e, e.name + (Type == WDL ? ".rtbw" : ".rtbz")))
+        return false;
+
+    const int sides = TBTable<Type>::Sides == 2 && (e.key != e.key2) ? 2 : 1;
+    const File maxFile = e.hasPawns ? FILE_D : FILE_A;
+
+    for (File f = FILE_A; f <= maxFile; ++f)
+        for (int i = 0; i < sides; i++) {
+            PairsData* d = e.get(i, f);
+            prefetch(d->sparseIndex, d->sparseIndexSize * sizeof(SparseEntry));
+            prefetch(d->blockLength, d->blockLengthSize * sizeof(uint16_t));
+        }
+
+    return true;
+}
+
+// Warm up the WDL and DTZ files of all the tables, reporting the progress with
+// info strings about every tenth of the files. Stops early if asked to.
+void TBTables::warm_up(const std::atomic_bool& stop) {
+
+    TimePoint start = now();
+    size_t total = wdlTable.size() + dtzTable.size(), done = 0, cnt = 0;
+
+    for (size_t i = 0; i < wdlTable.size(); ++i) {
+
+        if (stop)
+            return;
+
+        cnt += ::warm_up(wdlTable[i]) + ::warm_up(dtzTable[i]);
+        done += 2;
+
+        if (done < total && done * 10 / total != (done - 2) * 10 / total)
+            sync_cout << "info string Syzygy warm-up " << done << "/" << total
+                      << " files" << sync_endl;
+    }
+
+    sync_cout << "info string Syzygy warm-up done, " << cnt << " files mapped in "
+              << now() - start << " ms" << sync_endl;
 }
 
 template<TBType Type, typename Ret = typename TBTable<Type>::Ret>
@@ -1205,6 +1345,7 @@ WDLScore search(Position& pos, ProbeState* result) {
 /// safe, nor it needs to be.
 void Tablebases::init(const std::string& paths) {
 
+    WarmUp.cancel(); // Before clearing the tables it is reading
     TBTables.clear();
     MaxCardinality = 0;
     TBFile::Paths = paths;
@@ -1306,15 +1447,16 @@ void Tablebases::init(const std::string& paths) {
             LeadPawnsSize[leadPawnsCnt][f] = idx;
         }
 
-    // Add entries in TB tables if the corresponding ".rtbw" file exsists
-    for (PieceType p1 = PAWN; p1 < KING; ++p1) {
+    // Add entries in TB tables if the corresponding ".rtbw" file exsists. Only
+    // the chess pieces have Syzygy tables.
+    for (PieceType p1 = PAWN; p1 <= QUEEN; ++p1) {
         TBTables.add({KING, p1, KING});
 
         for (PieceType p2 = PAWN; p2 <= p1; ++p2) {
             TBTables.add({KING, p1, p2, KING});
             TBTables.add({KING, p1, KING, p2});
 
-            for (PieceType p3 = PAWN; p3 < KING; ++p3)
+            for (PieceType p3 = PAWN; p3 <= QUEEN; ++p3)
                 TBTables.add({KING, p1, p2, KING, p3});
 
             for (PieceType p3 = PAWN; p3 <= p2; ++p3) {
@@ -1323,7 +1465,7 @@ void Tablebases::init(const std::string& paths) {
                 for (PieceType p4 = PAWN; p4 <= p3; ++p4)
                     TBTables.add({KING, p1, p2, p3, p4, KING});
 
-                for (PieceType p4 = PAWN; p4 < KING; ++p4)
+                for (PieceType p4 = PAWN; p4 <= QUEEN; ++p4)
                     TBTables.add({KING, p1, p2, p3, KING, p4});
             }
 
@@ -1334,6 +1476,9 @@ void Tablebases::init(const std::string& paths) {
     }
 
     sync_cout << "info string Found " << TBTables.size() << " tablebases" << sync_endl;
+
+    if (Options["SyzygyWarmup"] && TBTables.size())
+        WarmUp.start();
 }
 
 // Probe the WDL table for a particular position.
@@ -22,6 +22,7 @@
 
 #include <ostream>
 
+#include "../misc.h"
 #include "../search.h"
 
 namespace Tablebases {
@@ -44,6 +45,17 @@ enum ProbeState {
     ZEROING_BEST_MOVE =  2  // Best move zeroes DTZ (capture or pawn move)
 };
 
+// Cache is a per-thread table of recent successful WDL probes, checked by the
+// search before the tables. The same endgame position is often reached by
+// other move orders, and this saves decoding it again. A WDL score does not
+// depend on the probe settings, so entries stay valid when they change.
+struct CacheEntry {
+    Key key;
+    WDLScore wdl;
+};
+
+typedef HashTable<CacheEntry, 4096> Cache;
+
 extern int MaxCardinality;
 
 void init(const std::string& paths);
@@ -32,7 +32,7 @@ void test_piece_creation() {
     manager.init();
     
     // Add a custom piece
-    manager.addPiece("CustomKnight", "N", 800, 900);
+    manager.addPiece("CustomKnight", "N", Value(800), Value(900));
     
     Betza::BetzaPiece* piece = manager.getPiece("CustomKnight");
     if (piece) {
@@ -100,8 +100,8 @@ void test_asymmetric_pieces() {
     manager.init();
     
     // Add different pieces for white and black
-    manager.addPiece("WhiteCustom", "N", 800, 900);
-    manager.addPiece("BlackCustom", "B", 850, 950);
+    manager.addPiece("WhiteCustom", "N", Value(800), Value(900));
+    manager.addPiece("BlackCustom", "B", Value(850), Value(950));
     
     Betza::BetzaPiece* whitePiece = manager.getPiece("WhiteCustom");
     Betza::BetzaPiece* blackPiece = manager.getPiece("BlackCustom");
@@ -115,6 +115,41 @@ void test_asymmetric_pieces() {
     cout << "Asymmetric pieces test completed." << endl << endl;
 }
 
+void test_compiled_pieces() {
+    cout << "Testing compiled attack tables..." << endl;
+    
+    Bitboards::init();
+    Betza::BetzaManager manager;
+    manager.init();
+    
+    // Custom pieces must get the same tables as the built-in equivalents
+    struct { const char* betza; PieceType builtin; } cases[] = {
+        { "BN", ARCHBISHOP }, { "RN", CHANCELLOR }, { "QN", DRAGON },
+        { "NB2", LEOPARD }, { "B2DN", SPIDER }, { "CN", UNICORN },
+        { "DHAG", HAWK }, { "KDA", ELEPHANT }, { "llNrrNDK", CANNON },
+        { "B3DvN", FORTRESS }, { "N", KNIGHT }, { "K", KING }
+    };
+    
+    int failures = 0;
+    for (const auto& tc : cases) {
+        PieceType pt = manager.addPiece(string("Compiled") + tc.betza, tc.betza);
+        for (Color c = WHITE; c <= BLACK; ++c)
+            for (Square s = SQ_A1; s <= SQ_H8; ++s)
+                for (Bitboard occupied : { Bitboard(0), Bitboard(0x00FF00000000FF00ULL), Bitboard(0x0000241818240000ULL) })
+                    if (   attacks_bb(c, pt, s, occupied) != attacks_bb(c, tc.builtin, s, occupied)
+                        || LeaperAttacks[c][pt][s] != LeaperAttacks[c][tc.builtin][s]) {
+                        cout << "Mismatch for '" << tc.betza << "' on square " << int(s) << endl;
+                        failures++;
+                        goto next;
+                    }
+    next:;
+    }
+    
+    cout << "Compiled attack tables test " << (failures ? "FAILED." : "completed.") << endl << endl;
+    if (failures)
+        exit(1);
+}
+
 int main() {
     cout << "=== Dynamic Betza Notation System Test ===" << endl << endl;
     
@@ -123,6 +158,7 @@ int main() {
     test_attack_generation();
     test_utility_functions();
     test_asymmetric_pieces();
+    test_compiled_pieces();
     
     cout << "=== All tests completed successfully! ===" << endl;
     cout << "The dynamic Betza notation system is working correctly." << endl;
@@ -26,17 +26,26 @@
 #include "thread.h"
 #include "uci.h"
 #include "syzygy/tbprobe.h"
+#include "timeman.h"
 #include "tt.h"
 
 ThreadPool Threads; // Global object
 
 
 /// Thread constructor launches the thread and waits until it goes to sleep
-/// in idle_loop(). Note that 'searching' and 'exit' should be alredy set.
+/// in idle_loop(). Note that 'searching' and 'exit' should be alredy set. A
+/// thread bound to a NUMA node is then woken up once more to reallocate its
+/// tables, which only now are all constructed.
 
 Thread::Thread(size_t n) : idx(n), stdThread(&Thread::idle_loop, this) {
 
   wait_for_search_finished();
+
+  if (firstTouch)
+  {
+      start_searching();
+      wait_for_search_finished();
+  }
 }
 
 
@@ -61,11 +70,15 @@ void Thread::clear() {
   mainHistory.fill(0);
   captureHistory.fill(0);
 
+  contHistory.resize(PieceIndexNb);
+
   for (auto& to : contHistory)
       for (auto& h : to)
           h.get()->fill(0);
 
   contHistory[NO_PIECE][0].get()->fill(Search::CounterMovePruneThreshold - 1);
+
+  evalCache.clear();
 }
 
 /// Thread::start_searching() wakes up the thread that will start the search
@@ -98,8 +111,11 @@ void Thread::idle_loop() {
   // some Windows NUMA hardware, for instance in fishtest. To make it simple,
   // just check if running threads are below a threshold, in this case all this
   // NUMA machinery is not needed.
-  if (Options["Threads"] >= 8)
-      WinProcGroup::bindThisThread(idx);
+  if (Options["Threads"] >= 8 || Options["Bind To Core"])
+  {
+      WinProcGroup::bindThisThread(idx, Options["Bind To Core"]);
+      firstTouch = true;
+  }
 
   while (true)
   {
@@ -113,6 +129,17 @@ void Thread::idle_loop() {
 
       lk.unlock();
 
+      // Reallocate and clear our tables from this thread, so that their pages
+      // are first touched, and so placed, on the NUMA node we are bound to.
+      if (firstTouch)
+      {
+          firstTouch = false;
+          pawnsTable = Pawns::Table();
+          materialTable = Material::Table();
+          clear();
+          continue;
+      }
+
       search();
   }
 }
@@ -135,6 +162,8 @@ void ThreadPool::set(size_t requested) {
 
       while (size() < requested)
           push_back(new Thread(size()));
+
+      set_eval_cache(Options["Eval Cache"]);
       clear();
   }
 
@@ -142,6 +171,87 @@ void ThreadPool::set(size_t requested) {
   TT.resize(Options["Hash"]);
 }
 
+/// ThreadPool::set_eval_cache() resizes the eval cache of every thread
+
+void ThreadPool::set_eval_cache(size_t mbSize) {
+
+  main()->wait_for_search_finished();
+
+  for (Thread* th : *this)
+      th->evalCache.resize(mbSize);
+}
+
+/// ThreadPool::stop_search() raises the stop flag and wakes up the threads
+/// waiting for it, i.e. the timer and a main thread done pondering.
+
+void ThreadPool::stop_search() {
+
+  {
+      std::lock_guard<Mutex> lk(stopMutex);
+      stop = true;
+  }
+  stopCondition.notify_all();
+}
+
+/// ThreadPool::ponderhit() switches from pondering to normal search, so that
+/// the timer starts counting against the deadline.
+
+void ThreadPool::ponderhit() {
+
+  {
+      std::lock_guard<Mutex> lk(stopMutex);
+      ponder = false;
+  }
+  stopCondition.notify_all();
+}
+
+/// ThreadPool::wait_for_stop() blocks the main thread, once it has finished a
+/// ponder or infinite search, until the GUI sends "stop" or "ponderhit".
+
+void ThreadPool::wait_for_stop() {
+
+  std::unique_lock<Mutex> lk(stopMutex);
+  stopCondition.wait(lk, [&]{ return stop || !(ponder || Search::Limits.infinite); });
+}
+
+/// ThreadPool::start_timer() launches a thread that raises the stop flag when
+/// the elapsed time reaches the deadline, so that the search threads don't
+/// have to poll the clock. The deadline is not enforced while pondering.
+
+void ThreadPool::start_timer(TimePoint deadline) {
+
+  timer = std::thread([this, deadline]() {
+
+      std::unique_lock<Mutex> lk(stopMutex);
+
+      while (!stop)
+      {
+          TimePoint remaining = deadline - Time.elapsed();
+
+          if (ponder)
+              stopCondition.wait(lk);
+
+          else if (remaining > 0)
+              stopCondition.wait_for(lk, std::chrono::milliseconds(remaining));
+
+          else
+          {
+              stop = true;
+              stopCondition.notify_all();
+          }
+      }
+  });
+}
+
+/// ThreadPool::join_timer() waits for the timer to exit after the stop flag
+/// has been raised with stop_search().
+
+void ThreadPool::join_timer() {
+
+  if (timer.joinable())
+      timer.join();
+}
+
 /// ThreadPool::clear() sets threadPool data to initial values.
 
 void ThreadPool::clear() {
@@ -182,22 +292,17 @@ void ThreadPool::start_thinking(Position& pos, StateListPtr& states,
   if (states.get())
       setupStates = std::move(states); // Ownership transfer, states is now empty
 
-  // We use Position::set() to set root position across threads. But there are
-  // some StateInfo fields (previous, pliesFromNull, capturedPiece) that cannot
-  // be deduced from a fen string, so set() clears them and to not lose the info
-  // we need to backup and later restore setupStates->back(). Note that setupStates
-  // is shared by threads but is accessed in read-only mode.
-  StateInfo tmp = setupStates->back();
+  // The root position is copied to every thread, sharing setupStates->back()
+  // and the previous states with 'pos'. Note that setupStates is shared by
+  // threads but is accessed in read-only mode.
 
   for (Thread* th : *this)
   {
-      th->nodes = th->tbHits = th->nmpMinPly = 0;
+      th->nodes = th->tbHits = th->tbCacheHits = th->tbCacheMisses = th->nmpMinPly = 0;
       th->rootDepth = th->completedDepth = DEPTH_ZERO;
       th->rootMoves = rootMoves;
-      th->rootPos.set(pos.fen(), pos.is_chess960(), &setupStates->back(), th);
+      th->rootPos.set(pos, th);
   }
 
-  setupStates->back() = tmp;
-
   main()->start_searching();
 }
@@ -27,12 +27,14 @@
 #include <thread>
 #include <vector>
 
+#include "evaluate.h"
 #include "material.h"
 #include "movepick.h"
 #include "pawns.h"
 #include "position.h"
 #include "search.h"
 #include "thread_win32.h"
+#include "syzygy/tbprobe.h"
 
 
 /// Thread class keeps together all the thread-related stuff. We use
@@ -45,7 +47,7 @@ class Thread {
   Mutex mutex;
   ConditionVariable cv;
   size_t idx;
-  bool exit = false, searching = true; // Set before starting std::thread
+  bool exit = false, searching = true, firstTouch = false; // Set before starting std::thread
   std::thread stdThread;
 
 public:
@@ -59,11 +61,13 @@ public:
 
   Pawns::Table pawnsTable;
   Material::Table materialTable;
+  Eval::Cache evalCache;
+  Tablebases::Cache tbCache;
   Endgames endgames;
   size_t pvIdx, pvLast;
   int selDepth, nmpMinPly;
   Color nmpColor;
-  std::atomic<uint64_t> nodes, tbHits;
+  std::atomic<uint64_t> nodes, tbHits, tbCacheHits, tbCacheMisses;
 
   Position rootPos;
   Search::RootMoves rootMoves;
@@ -101,16 +105,28 @@ struct ThreadPool : public std::vector<Thread*> {
   void start_thinking(Position&, StateListPtr&, const Search::LimitsType&, bool = false);
   void clear();
   void set(size_t);
+  void set_eval_cache(size_t);
+  void stop_search();
+  void ponderhit();
+  void wait_for_stop();
+  void start_timer(TimePoint deadline);
+  void join_timer();
 
   MainThread* main()        const { return static_cast<MainThread*>(front()); }
   uint64_t nodes_searched() const { return accumulate(&Thread::nodes); }
   uint64_t tb_hits()        const { return accumulate(&Thread::tbHits); }
+  uint64_t tb_cache_hits()  const { return accumulate(&Thread::tbCacheHits); }
+  uint64_t tb_cache_misses() const { return accumulate(&Thread::tbCacheMisses); }
 
   std::atomic_bool stop, ponder, stopOnPonderhit;
 
   StateListPtr setupStates;
 
 private:
+  Mutex stopMutex;
+  ConditionVariable stopCondition;
+  std::thread timer;
+
   uint64_t accumulate(std::atomic<uint64_t> Thread::* member) const {
 
     uint64_t sum = 0;
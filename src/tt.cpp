@@ -18,10 +18,21 @@
   along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 
+#include <atomic>
+#include <cerrno>
+#include <chrono>
 #include <cstring>   // For std::memset
+#include <fstream>
 #include <iostream>
 #include <thread>
 
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
 #include "bitboard.h"
 #include "misc.h"
 #include "tt.h"
@@ -29,37 +40,314 @@
 
 TranspositionTable TT; // Our global transposition table
 
+namespace {
+
+// Bump KeySchemeVersion whenever the Zobrist keys or the layout of TTEntry
+// change, so that hash files written by older versions are rejected.
+constexpr uint32_t KeySchemeVersion = 1;
+constexpr char HashFileMagic[8] = { 'M', 'U', 'S', 'K', 'H', 'A', 'S', 'H' };
+
+// A hash file is this header followed by the cluster array. The header
+// fills a cache line so that a mapped cluster array stays aligned.
+struct HashFileHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t clusterSize;
+  uint64_t clusterCount;
+  uint8_t generation8;
+  char padding[39];
+};
+
+static_assert(sizeof(HashFileHeader) == 64, "Hash file header size incorrect");
+
+constexpr uint32_t SharedHashMagic = 0x4D534854;
+
+} // namespace
+
+// A shared hash segment is this header followed by the cluster array. The
+// creator sets 'magic' last, so that processes attaching to a segment still
+// being initialized can wait for it.
+struct TranspositionTable::SharedHeader {
+  std::atomic<uint32_t> magic;
+  std::atomic<uint32_t> users;
+  uint64_t clusterCount;
+  std::atomic<uint8_t> generation8;
+  char padding[47];
+};
+
+static_assert(sizeof(TranspositionTable::SharedHeader) == 64, "Shared hash header size incorrect");
+
 
 /// TranspositionTable::resize() sets the size of the transposition table,
 /// measured in megabytes. Transposition table consists of a power of 2 number
 /// of clusters and each cluster consists of ClusterSize number of TTEntry.
+/// The table is backed by huge pages when the Large Pages option allows it,
+/// or lives in the shared memory segment named by the Shared Hash option.
 
 void TranspositionTable::resize(size_t mbSize) {
 
+  free_table();
+
   clusterCount = mbSize * 1024 * 1024 / sizeof(Cluster);
 
-  free(mem);
-  mem = malloc(clusterCount * sizeof(Cluster) + CacheLineSize - 1);
+  std::string sharedHash = Options["Shared Hash"];
+  if (!sharedHash.empty() && sharedHash != "<empty>" && attach_shared(sharedHash))
+      return;
+
+  table = (Cluster*)large_pages_alloc(clusterCount * sizeof(Cluster), Options["Large Pages"], pageKind);
 
-  if (!mem)
+  if (!table)
   {
       std::cerr << "Failed to allocate " << mbSize
                 << "MB for transposition table." << std::endl;
       exit(EXIT_FAILURE);
   }
 
-  table = (Cluster*)((uintptr_t(mem) + CacheLineSize - 1) & ~(CacheLineSize - 1));
   clear();
 }
 
 
+/// TranspositionTable::attach_shared() places the table in a named POSIX shared
+/// memory segment, creating it if no other process did yet. All the processes
+/// attached to a segment must use the same Hash size. Entries are read and
+/// written without locks as within a single process, and the generation is
+/// kept in the segment so that all processes age entries together. The last
+/// process to detach removes the segment; after a crash it stays until it is
+/// removed by hand from /dev/shm.
+
+bool TranspositionTable::attach_shared(std::string name) {
+
+#ifndef _WIN32
+  if (name[0] != '/')
+      name = "/" + name;
+
+  const size_t size = sizeof(SharedHeader) + clusterCount * sizeof(Cluster);
+  bool created = true;
+  int fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+
+  if (fd == -1 && errno == EEXIST)
+  {
+      created = false;
+      fd = shm_open(name.c_str(), O_RDWR, 0);
+  }
+
+  if (fd == -1)
+  {
+      sync_cout << "info string Could not open shared hash " << name << sync_endl;
+      return false;
+  }
+
+  if (created && ftruncate(fd, size))
+  {
+      close(fd);
+      shm_unlink(name.c_str());
+      sync_cout << "info string Could not size shared hash " << name << sync_endl;
+      return false;
+  }
+
+  // Give the creator of the segment some time to size it
+  struct stat st;
+  for (int i = 0; i < 100 && !fstat(fd, &st) && st.st_size == 0; ++i)
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+
+  void* mem =  fstat(fd, &st) || size_t(st.st_size) != size ? MAP_FAILED
+             : mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+
+  if (mem == MAP_FAILED)
+  {
+      sync_cout << "info string Shared hash " << name << " has a different Hash size" << sync_endl;
+      return false;
+  }
+
+  SharedHeader* header = (SharedHeader*)mem;
+
+  if (created)
+  {
+      // A new segment is zero filled, which is an empty table
+      header->clusterCount = clusterCount;
+      header->generation8 = 0;
+      header->magic.store(SharedHashMagic, std::memory_order_release);
+  }
+  else
+      for (int i = 0; i < 100 && header->magic.load(std::memory_order_acquire) != SharedHashMagic; ++i)
+          std::this_thread::sleep_for(std::chrono::milliseconds(10));
+
+  if (header->magic.load(std::memory_order_acquire) != SharedHashMagic)
+  {
+      munmap(mem, size);
+      sync_cout << "info string Shared hash " << name << " is not initialized" << sync_endl;
+      return false;
+  }
+
+  header->users++;
+  shared = header;
+  sharedName = name;
+  mappedSize = size;
+  table = (Cluster*)(header + 1);
+  generation8 = header->generation8;
+  return true;
+#else
+  sync_cout << "info string Shared hash is not supported on this platform" << sync_endl;
+  return false;
+#endif
+}
+
+
+/// TranspositionTable::new_search() advances the generation at the start of
+/// a search. With a shared hash, the generation of the segment is advanced,
+/// so that entries written by other processes are not aged needlessly.
+
+void TranspositionTable::new_search() {
+
+  // Lower 2 bits are used by Bound
+  generation8 = shared ? shared->generation8 += 4 : generation8 + 4;
+}
+
+
+/// TranspositionTable::free_table() releases the cluster array, whether it
+/// was allocated by resize(), mapped from a file by load() or attached to a
+/// shared memory segment.
+
+void TranspositionTable::free_table() {
+
+#ifndef _WIN32
+  if (shared)
+  {
+      if (--shared->users == 0)
+          shm_unlink(sharedName.c_str());
+
+      munmap(shared, mappedSize);
+      shared = nullptr;
+      mappedSize = 0;
+      table = nullptr;
+      return;
+  }
+
+  if (mappedSize)
+  {
+      munmap((char*)table - sizeof(HashFileHeader), mappedSize);
+      mappedSize = 0;
+      table = nullptr;
+      return;
+  }
+#endif
+
+  large_pages_free(table, clusterCount * sizeof(Cluster), pageKind);
+  table = nullptr;
+}
+
+
+/// TranspositionTable::save() writes the transposition table to a file, so
+/// that a later session can continue with it through load().
+
+void TranspositionTable::save(const std::string& file) const {
+
+  HashFileHeader header = {};
+  std::memcpy(header.magic, HashFileMagic, sizeof(header.magic));
+  header.version = KeySchemeVersion;
+  header.clusterSize = sizeof(Cluster);
+  header.clusterCount = clusterCount;
+  header.generation8 = generation8;
+
+  std::ofstream out(file, std::ios::binary);
+  out.write((const char*)&header, sizeof(header));
+  out.write((const char*)table, clusterCount * sizeof(Cluster));
+
+  if (out)
+      sync_cout << "info string Hash saved to " << file << sync_endl;
+  else
+      sync_cout << "info string Could not write hash to " << file << sync_endl;
+}
+
+
+/// TranspositionTable::load() replaces the transposition table with the one
+/// stored in a file by save(). The file must have been written with the same
+/// key scheme and the same Hash size. With useMmap the file is mapped copy on
+/// write instead of read, so that a large table is usable at once and its
+/// pages are read from disk on first access.
+
+void TranspositionTable::load(const std::string& file, bool useMmap) {
+
+  HashFileHeader header;
+  std::ifstream in(file, std::ios::binary);
+
+  if (!in.read((char*)&header, sizeof(header)))
+  {
+      sync_cout << "info string Could not read hash from " << file << sync_endl;
+      return;
+  }
+
+  if (   std::memcmp(header.magic, HashFileMagic, sizeof(header.magic))
+      || header.version != KeySchemeVersion
+      || header.clusterSize != sizeof(Cluster))
+  {
+      sync_cout << "info string " << file << " is not a hash file of this version" << sync_endl;
+      return;
+  }
+
+  if (header.clusterCount != clusterCount)
+  {
+      sync_cout << "info string " << file << " needs Hash set to "
+                << header.clusterCount * sizeof(Cluster) / (1024 * 1024) << " MB" << sync_endl;
+      return;
+  }
+
+#ifndef _WIN32
+  if (useMmap)
+  {
+      size_t size = sizeof(header) + clusterCount * sizeof(Cluster);
+      int fd = open(file.c_str(), O_RDONLY);
+      struct stat st;
+      void* mem = fd == -1 || fstat(fd, &st) || size_t(st.st_size) != size ? MAP_FAILED
+                : mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+
+      if (fd != -1)
+          close(fd);
+
+      if (mem == MAP_FAILED)
+      {
+          sync_cout << "info string Could not map hash from " << file << sync_endl;
+          return;
+      }
+
+      free_table();
+      table = (Cluster*)((char*)mem + sizeof(header));
+      mappedSize = size;
+      generation8 = header.generation8;
+      sync_cout << "info string Hash mapped from " << file << sync_endl;
+      return;
+  }
+#else
+  (void)useMmap;
+#endif
+
+  if (!in.read((char*)table, clusterCount * sizeof(Cluster)))
+  {
+      clear();
+      sync_cout << "info string Could not read hash from " << file << sync_endl;
+      return;
+  }
+
+  generation8 = header.generation8;
+  if (shared)
+      shared->generation8 = generation8;
+
+  sync_cout << "info string Hash loaded from " << file << sync_endl;
+}
+
+
 /// TranspositionTable::clear() overwrites the entire transposition table
 /// with zeros. It is called whenever the table is resized, or when the
 /// user asks the program to clear the table (from the UCI interface).
-/// It starts as many threads as allowed by the Threads option.
+/// It starts as many threads as allowed by the Threads option. A shared
+/// table is left alone, because other processes are still using it.
 
 void TranspositionTable::clear() {
 
+  if (shared)
+      return;
+
   const size_t stride = clusterCount / Options["Threads"];
   std::vector<std::thread> threads;
   for (size_t idx = 0; idx < Options["Threads"]; idx++)
@@ -69,8 +357,8 @@ void TranspositionTable::clear() {
                             stride :
                             clusterCount - start;
       threads.push_back(std::thread([this, idx, start, len]() {
-          if (Options["Threads"] >= 8)
-              WinProcGroup::bindThisThread(idx);
+          if (Options["Threads"] >= 8 || Options["Bind To Core"])
+              WinProcGroup::bindThisThread(idx, Options["Bind To Core"]);
           std::memset(&table[start], 0, len * sizeof(Cluster));
       }));
   }
@@ -96,23 +96,35 @@ class TranspositionTable {
   static_assert(CacheLineSize % sizeof(Cluster) == 0, "Cluster size incorrect");
 
 public:
- ~TranspositionTable() { free(mem); }
-  void new_search() { generation8 += 4; } // Lower 2 bits are used by Bound
+ ~TranspositionTable() { free_table(); }
+  void new_search();
   uint8_t generation() const { return generation8; }
   TTEntry* probe(const Key key, bool& found) const;
   int hashfull() const;
   void resize(size_t mbSize);
   void clear();
+  void save(const std::string& file) const;
+  void load(const std::string& file, bool useMmap);
+  PageKind page_kind() const { return pageKind; }
+  bool is_shared() const { return shared; }
 
   // The 32 lowest order bits of the key are used to get the index of the cluster
   TTEntry* first_entry(const Key key) const {
     return &table[(uint32_t(key) * uint64_t(clusterCount)) >> 32].entry[0];
   }
 
+  struct SharedHeader;
+
 private:
+  bool attach_shared(std::string name);
+  void free_table();
+
   size_t clusterCount;
   Cluster* table;
-  void* mem;
+  PageKind pageKind;
+  size_t mappedSize; // Non-zero when the table is mapped from a file or shared
+  SharedHeader* shared;
+  std::string sharedName;
   uint8_t generation8; // Size must be not bigger than TTEntry::genBound8
 };
 
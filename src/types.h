@@ -248,7 +248,7 @@ enum PieceType {
 static_assert(PIECE_TYPE_BITS <= 6, "PIECE_TYPE uses more than 6 bit");
 static_assert(!(PIECE_TYPE_NB & (PIECE_TYPE_NB - 1)), "PIECE_TYPE_NB is not a power of 2");
 
-enum Piece {
+enum Piece : uint8_t {
   NO_PIECE,
   PIECE_NB = 2 * PIECE_TYPE_NB
 };
@@ -258,6 +258,21 @@ const std::string PieceToChar(  " PNBRQCLAMSDUHEFK" + std::string(PIECE_TYPE_NB
 
 extern Value PieceValue[PHASE_NB][PIECE_NB];
 
+/// PieceTypeEnd is one past the last piece type with attack tables: CUSTOM_1
+/// until custom pieces are registered, so that loops from PAWN to KING extend
+/// to the custom pieces in use.
+extern PieceType PieceTypeEnd;
+
+/// PieceIndex maps the pieces in play (the built-in types and the registered
+/// custom pieces of both colors) to a dense range [1, PieceIndexNb), leaving 0
+/// for NO_PIECE. Per-thread history tables are sized and addressed by it.
+extern uint8_t PieceIndex[PIECE_NB];
+extern int PieceIndexNb;
+
+/// SeeOrder lists the piece types in play by increasing midgame value, with
+/// the king last, so that see_ge() picks the least valuable attacker first.
+extern PieceType SeeOrder[PIECE_TYPE_NB];
+
 enum Depth : int {
 
   ONE_PLY = 1,
@@ -273,7 +288,7 @@ enum Depth : int {
 
 static_assert(!(ONE_PLY & (ONE_PLY - 1)), "ONE_PLY is not a power of 2");
 
-enum Square : int {
+enum Square : int8_t {
   SQ_A1, SQ_B1, SQ_C1, SQ_D1, SQ_E1, SQ_F1, SQ_G1, SQ_H1,
   SQ_A2, SQ_B2, SQ_C2, SQ_D2, SQ_E2, SQ_F2, SQ_G2, SQ_H2,
   SQ_A3, SQ_B3, SQ_C3, SQ_D3, SQ_E3, SQ_F3, SQ_G3, SQ_H3,
@@ -18,12 +18,15 @@
   along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 
+#include <algorithm>
 #include <cassert>
 #include <iostream>
 #include <sstream>
 #include <string>
+#include <vector>
 
 #include "evaluate.h"
+#include "fairytb.h"
 #include "movegen.h"
 #include "position.h"
 #include "search.h"
@@ -37,22 +40,51 @@
 using namespace std;
 
 extern vector<string> setup_bench(const Position&, istream&);
+extern void microbench(istream&);
 
 namespace {
 
   // FEN string of the initial position, normal chess
   const char* StartFEN = "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1";
 
+  // The last position set up by position(), so that a command that only
+  // appends moves to it, as GUIs send during a game, applies just those.
+  struct LastPosition {
+    string fen;
+    bool chess960;
+    vector<string> moves;
+    Key key;
+    int generation;
+  } lastPosition;
+
+
+  // to_square() converts a file and a rank character to a square, if valid
+
+  Square to_square(char file, char rank) {
+    return file >= 'a' && file <= 'h' && rank >= '1' && rank <= '8'
+          ? make_square(File(file - 'a'), Rank(rank - '1')) : SQ_NONE;
+  }
+
+
+  // to_piece_type() converts a piece character of either color to its type
+
+  PieceType to_piece_type(char c) {
+    size_t idx = PieceToChar.find(c);
+    return idx != string::npos ? type_of(Piece(idx)) : NO_PIECE_TYPE;
+  }
+
 
   // position() is called when engine receives the "position" UCI command.
   // The function sets up the position described in the given FEN string ("fen")
   // or the starting position ("startpos") and then makes the moves given in the
-  // following move list ("moves").
+  // following move list ("moves"). When the command repeats the previous one
+  // with more moves, only the new moves are made.
 
   void position(Position& pos, istringstream& is, StateListPtr& states) {
 
     Move m;
     string token, fen;
+    vector<string> moves;
 
     is >> token;
 
@@ -67,22 +99,57 @@ namespace {
     else
         return;
 
-    states = StateListPtr(new std::deque<StateInfo>(1)); // Drop old and create a new one
-    pos.set(fen, Options["UCI_Chess960"], &states->back(), Threads.main());
+    while (is >> token)
+        moves.push_back(token);
+
+    // After a 'go' the states are owned by the thread pool, take them back once
+    // the search is over. A running search (e.g. 'go infinite') is not waited
+    // for, as only this thread can read the "stop" that ends it, and the
+    // position is set up from scratch instead.
+    if (!states.get() && Threads.setupStates.get() && Threads.stop)
+    {
+        Threads.main()->wait_for_search_finished();
+        states = std::move(Threads.setupStates);
+    }
+
+    size_t ply = lastPosition.moves.size();
+
+    if (   !states.get()
+        || fen != lastPosition.fen
+        || bool(Options["UCI_Chess960"]) != lastPosition.chess960
+        || pos.key() != lastPosition.key
+        || ComponentGeneration != lastPosition.generation
+        || moves.size() < ply
+        || !std::equal(lastPosition.moves.begin(), lastPosition.moves.end(), moves.begin()))
+    {
+        states = StateListPtr(new std::deque<StateInfo>(1)); // Drop old and create a new one
+        pos.set(fen, Options["UCI_Chess960"], &states->back(), Threads.main());
+        lastPosition.moves.clear();
+        ply = 0;
+    }
 
     // Parse move list (if any)
-    while (is >> token && (m = UCI::to_move(pos, token)) != MOVE_NONE)
+    for ( ; ply < moves.size() && (m = UCI::to_move(pos, moves[ply])) != MOVE_NONE; ++ply)
     {
         states->emplace_back();
         pos.do_move(m, states->back());
+        lastPosition.moves.push_back(moves[ply]);
     }
+
+    lastPosition.fen = fen;
+    lastPosition.chess960 = Options["UCI_Chess960"];
+    lastPosition.key = pos.key();
+    lastPosition.generation = ComponentGeneration;
   }
 
 
   // setoption() is called when engine receives the "setoption" UCI command. The
-  // function updates the UCI option ("name") to the given value ("value").
+  // function updates the UCI option ("name") to the given value ("value"). If
+  // this changes the piece set, the position is set up again.
 
-  void setoption(istringstream& is) {
+  void setoption(Position& pos, istringstream& is, StateListPtr& states) {
+
+    int generation = ComponentGeneration;
 
     string token, name, value;
 
@@ -100,6 +167,19 @@ namespace {
         Options[name] = value;
     else
         sync_cout << "No such option: " << name << sync_endl;
+
+    // The components were renumbered and 'pos' is stale, see ComponentGeneration.
+    // Replay the last "position" command from scratch.
+    if (ComponentGeneration != generation)
+    {
+        string cmd = "fen " + (lastPosition.fen.empty() ? pos.fen() : lastPosition.fen) + " moves";
+        for (const string& m : lastPosition.moves)
+            cmd += " " + m;
+
+        lastPosition = LastPosition();
+        istringstream ss(cmd);
+        position(pos, ss, states);
+    }
   }
 
 
@@ -144,7 +224,7 @@ namespace {
   void bench(Position& pos, istream& args, StateListPtr& states) {
 
     string token;
-    uint64_t num, nodes = 0, cnt = 1;
+    uint64_t num, nodes = 0, tbCacheHits = 0, tbCacheProbes = 0, cnt = 1;
 
     vector<string> list = setup_bench(pos, args);
     num = count_if(list.begin(), list.end(), [](string s) { return s.find("go ") == 0; });
@@ -162,20 +242,50 @@ namespace {
             go(pos, is, states);
             Threads.main()->wait_for_search_finished();
             nodes += Threads.nodes_searched();
+            tbCacheHits += Threads.tb_cache_hits();
+            tbCacheProbes += Threads.tb_cache_hits() + Threads.tb_cache_misses();
         }
-        else if (token == "setoption")  setoption(is);
+        else if (token == "setoption")  setoption(pos, is, states);
         else if (token == "position")   position(pos, is, states);
         else if (token == "ucinewgame") Search::clear();
     }
 
     elapsed = now() - elapsed + 1; // Ensure positivity to avoid a 'divide by zero'
 
+    uint64_t evalHits = 0, evalProbes = 0;
+    for (Thread* th : Threads)
+        evalHits += th->evalCache.hits, evalProbes += th->evalCache.probes;
+
     dbg_print(); // Just before exiting
 
     cerr << "\n==========================="
          << "\nTotal time (ms) : " << elapsed
          << "\nNodes searched  : " << nodes
-         << "\nNodes/second    : " << 1000 * nodes / elapsed << endl;
+         << "\nNodes/second    : " << 1000 * nodes / elapsed
+         << "\nEval cache hits : " << evalHits << "/" << evalProbes
+         << " (" << 100 * evalHits / std::max(evalProbes, uint64_t(1)) << "%)"
+         << "\nTB cache hits   : " << tbCacheHits << "/" << tbCacheProbes
+         << " (" << 100 * tbCacheHits / std::max(tbCacheProbes, uint64_t(1)) << "%)" << endl;
+  }
+
+
+  // tbgen() is called when engine receives the "tbgen <code> [<dir>]" command,
+  // for example "tbgen KAvKR /tb". It generates the fairy tablebases of the
+  // endgame, using all the threads, and writes them in the directory.
+
+  void tbgen(istringstream& is) {
+
+    string code, dir = ".";
+
+    if (!(is >> code))
+    {
+        sync_cout << "info string Missing endgame code for tbgen" << sync_endl;
+        return;
+    }
+
+    is >> dir;
+    Threads.main()->wait_for_search_finished();
+    FairyTablebases::generate(code, dir);
   }
 
 } // namespace
@@ -219,10 +329,10 @@ void UCI::loop(int argc, char* argv[]) {
       if (    token == "quit"
           ||  token == "stop"
           || (token == "ponderhit" && Threads.stopOnPonderhit))
-          Threads.stop = true;
+          Threads.stop_search();
 
       else if (token == "ponderhit")
-          Threads.ponder = false; // Switch to normal search
+          Threads.ponderhit(); // Switch to normal search
 
       else if (token == "uci" || token == "xboard")
       {
@@ -241,7 +351,7 @@ void UCI::loop(int argc, char* argv[]) {
                     << "\n"       << Options
                     << "\nuciok"  << sync_endl;
 
-      else if (token == "setoption")  setoption(is);
+      else if (token == "setoption")  setoption(pos, is, states);
       else if (token == "go")         go(pos, is, states);
       else if (token == "position")   position(pos, is, states);
       else if (token == "ucinewgame") Search::clear();
@@ -250,8 +360,11 @@ void UCI::loop(int argc, char* argv[]) {
       // Additional custom non-UCI commands, mainly for debugging
       else if (token == "flip")  pos.flip();
       else if (token == "bench") bench(pos, is, states);
+      else if (token == "microbench") microbench(is);
       else if (token == "d")     sync_cout << pos << sync_endl;
       else if (token == "eval")  sync_cout << Eval::trace(pos) << sync_endl;
+      else if (token == "savehash" || token == "loadhash") hash_file(token, is);
+      else if (token == "tbgen") tbgen(is);
       else
           sync_cout << "Unknown command: " << cmd << sync_endl;
 
@@ -259,6 +372,30 @@ void UCI::loop(int argc, char* argv[]) {
 }
 
 
+/// UCI::hash_file() handles the "savehash <file>" and "loadhash <file> [mmap]"
+/// commands, which store the transposition table in a file and restore it
+/// in a later session. Like setoption, they are not meant to be sent during
+/// a search. Send loadhash after ucinewgame, which clears the hash.
+
+void UCI::hash_file(const string& cmd, istream& is) {
+
+  string file, token;
+
+  if (!(is >> file))
+  {
+      sync_cout << "info string Missing file name for " << cmd << sync_endl;
+      return;
+  }
+
+  Threads.main()->wait_for_search_finished();
+
+  if (cmd == "savehash")
+      TT.save(file);
+  else
+      TT.load(file, (is >> token) && token == "mmap");
+}
+
+
 /// UCI::value() converts a Value to a string suitable for use with the UCI
 /// protocol specification:
 ///
@@ -334,19 +471,64 @@ string UCI::move(Move m, const Position& pos) {
 
 
 /// UCI::to_move() converts a string representing a move in coordinate notation
-/// (g1f3, a7a8q) to the corresponding legal Move, if any.
+/// (g1f3, a7a8q, gating selections like C and placements like C@d0) to the
+/// corresponding legal Move, if any. The move is decoded from the string and
+/// then validated, rather than searched for in the list of legal moves.
 
 Move UCI::to_move(const Position& pos, string& str) {
 
   if (str.length() == 5) // Junior could send promotion piece in uppercase
       str[4] = char(tolower(str[4]));
 
-  // allow optional gating suffix
-  string strNoSuffix = str.substr(0, 4);
+  Color us = pos.side_to_move();
+  Move m = MOVE_NONE;
+
+  if (str.length() == 1)
+      m = make<SET_GATING_TYPE>(SQ_A1, SQ_A1, to_piece_type(str[0]));
 
-  for (const auto& m : MoveList<LEGAL>(pos))
-      if (str == UCI::move(m, pos) || strNoSuffix == UCI::move(m, pos))
-          return m;
+  else if (str.length() == 4 && str[1] == '@')
+  {
+      Square to = to_square(str[2], us == WHITE ? '1' : '8');
+
+      if (to != SQ_NONE && str[3] == (us == WHITE ? '0' : '9'))
+          m = make<PUT_GATING_PIECE>(SQ_A1, to, to_piece_type(str[0]));
+  }
+  else if (str.length() >= 4)
+  {
+      // Allow an optional gating suffix on other moves
+      Square from = to_square(str[0], str[1]);
+      Square to = to_square(str[2], str[3]);
+
+      if (from == SQ_NONE || to == SQ_NONE)
+          return MOVE_NONE;
+
+      PieceType pt = type_of(pos.piece_on(from));
+      CastlingRight cr = us | (to > from ? KING_SIDE : QUEEN_SIDE);
+
+      if (pt == PAWN && rank_of(to) == relative_rank(us, RANK_8))
+      {
+          PieceType promotion = str.length() == 5 ? to_piece_type(str[4]) : NO_PIECE_TYPE;
+
+          m =  file_of(to) < file_of(from) ? make<PROMOTION_LEFT>(from, to, promotion)
+             : file_of(to) > file_of(from) ? make<PROMOTION_RIGHT>(from, to, promotion)
+                                           : make<PROMOTION_STRAIGHT>(from, to, promotion);
+
+          if (promotion == NO_PIECE_TYPE || from_sq(m) != from)
+              return MOVE_NONE;
+      }
+      else if (pt == PAWN && to == pos.ep_square())
+          m = make<ENPASSANT>(from, to);
+
+      // Castling is sent as king to rook in Chess960, and as e1g1 otherwise
+      else if (   pt == KING
+               && pos.can_castle(cr)
+               && (pos.is_chess960() ? to == pos.castling_rook_square(cr)
+                                     : distance<File>(from, to) == 2))
+          m = make<CASTLING>(from, pos.castling_rook_square(cr));
+
+      else
+          m = make_move(from, to);
+  }
 
-  return MOVE_NONE;
+  return m != MOVE_NONE && pos.pseudo_legal(m) && pos.legal(m) ? m : MOVE_NONE;
 }
@@ -77,6 +77,7 @@ std::string square(Square s);
 std::string move(Move m, const Position& pos);
 std::string pv(const Position& pos, Depth depth, Value alpha, Value beta);
 Move to_move(const Position& pos, std::string& str);
+void hash_file(const std::string& cmd, std::istream& is);
 
 } // namespace UCI
 
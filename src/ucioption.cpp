@@ -24,6 +24,7 @@
 #include <iostream>
 #include <sstream>
 
+#include "fairytb.h"
 #include "misc.h"
 #include "search.h"
 #include "thread.h"
@@ -39,12 +40,33 @@ UCI::OptionsMap Options; // Global object
 
 namespace UCI {
 
+/// report_hash_pages() tells the GUI which kind of pages backs the hash table
+
+void report_hash_pages() {
+
+  static const char* PageNames[] = { "normal pages", "transparent huge pages",
+                                     "2 MB huge pages", "1 GB huge pages" };
+
+  if (TT.is_shared())
+      sync_cout << "info string Hash " << int(Options["Hash"]) << " MB shared as "
+                << std::string(Options["Shared Hash"]) << sync_endl;
+  else
+      sync_cout << "info string Hash " << int(Options["Hash"]) << " MB using "
+                << PageNames[TT.page_kind()] << sync_endl;
+}
+
 /// 'On change' actions, triggered by an option's value change
 void on_clear_hash(const Option&) { Search::clear(); }
-void on_hash_size(const Option& o) { TT.resize(o); }
+void on_hash_size(const Option& o) { TT.resize(o); report_hash_pages(); }
+void on_large_pages(const Option&) { TT.resize(Options["Hash"]); report_hash_pages(); }
+void on_shared_hash(const Option&) { TT.resize(Options["Hash"]); report_hash_pages(); }
+void on_eval_cache(const Option& o) { Threads.set_eval_cache(o); }
 void on_logger(const Option& o) { start_logger(o); }
 void on_threads(const Option& o) { Threads.set(o); }
+void on_bind_to_core(const Option&) { Threads.set(Options["Threads"]); }
 void on_tb_path(const Option& o) { Tablebases::init(o); }
+void on_tb_warmup(const Option&) { Tablebases::init(Options["SyzygyPath"]); }
+void on_fairy_tb_path(const Option& o) { FairyTablebases::init(o); }
 void on_variant(const Option& o) {
     if (Options["Protocol"] == "xboard")
     {
@@ -83,6 +105,8 @@ void on_custom_pieces(const Option& o) {
     
     std::string pieceString = (std::string)o;
     if (pieceString.empty() || pieceString == "<empty>") {
+        Position::init_cuckoo();
+        Search::clear(); // History tables are sized by the pieces in play
         sync_cout << "info string Custom pieces cleared" << sync_endl;
         return;
     }
@@ -106,13 +130,19 @@ void on_custom_pieces(const Option& o) {
             betza.erase(betza.find_last_not_of(" \t") + 1);
             
             if (!name.empty() && !betza.empty()) {
-                Betza::betzaManager.addPiece(name, betza);
+                if (Betza::betzaManager.addPiece(name, betza) == NO_PIECE_TYPE) {
+                    sync_cout << "info string No free piece type for custom piece: " << name << sync_endl;
+                    continue;
+                }
                 pieceCount++;
                 sync_cout << "info string Added custom piece: " << name << " (" << betza << ")" << sync_endl;
             }
         }
     }
     
+    Position::init_cuckoo();
+    Search::clear(); // History tables are sized by the pieces in play
+
     if (pieceCount > 0) {
         sync_cout << "info string Loaded " << pieceCount << " custom pieces" << sync_endl;
     }
@@ -139,8 +169,12 @@ void init(OptionsMap& o) {
   o["Contempt"]              << Option(21, -100, 100);
   o["Analysis Contempt"]     << Option("Both", {"Both", "Off", "White", "Black"});
   o["Threads"]               << Option(1, 1, 512, on_threads);
+  o["Bind To Core"]          << Option(false, on_bind_to_core);
   o["Hash"]                  << Option(16, 1, MaxHashMB, on_hash_size);
+  o["Large Pages"]           << Option("Auto", {"Auto", "Transparent", "Off"}, on_large_pages);
+  o["Shared Hash"]           << Option("<empty>", on_shared_hash);
   o["Clear Hash"]            << Option(on_clear_hash);
+  o["Eval Cache"]            << Option(0, 0, 1024, on_eval_cache);
   o["Ponder"]                << Option(false);
   o["MultiPV"]               << Option(1, 1, 500);
   o["Skill Level"]           << Option(20, 0, 20);
@@ -156,6 +190,8 @@ void init(OptionsMap& o) {
   o["SyzygyProbeDepth"]      << Option(1, 1, 100);
   o["Syzygy50MoveRule"]      << Option(true);
   o["SyzygyProbeLimit"]      << Option(6, 0, 6);
+  o["SyzygyWarmup"]          << Option(false, on_tb_warmup);
+  o["FairyTBPath"]           << Option("<empty>", on_fairy_tb_path);
 }
 
 
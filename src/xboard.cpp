@@ -20,6 +20,7 @@
 #include <string>
 
 #include "evaluate.h"
+#include "movegen.h"
 #include "search.h"
 #include "thread.h"
 #include "types.h"
@@ -93,7 +94,7 @@ const char* StartFEN = "lc******/rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR/LC*
 void StateMachine::process_command(Position& pos, std::string token, std::istringstream& is, StateListPtr& states) {
   if (moveAfterSearch)
   {
-      Threads.stop = true;
+      Threads.stop_search();
       Threads.main()->wait_for_search_finished();
       do_move(pos, moveList, states, Threads.main()->bestThread->rootMoves[0].pv[0]);
       moveAfterSearch = false;
@@ -116,6 +117,8 @@ void StateMachine::process_command(Position& pos, std::string token, std::istrin
   {
       Search::clear();
       setboard(pos, states);
+      startFen.clear();
+      moveList.clear();
       // play second by default
       playColor = ~pos.side_to_move();
   }
@@ -124,6 +127,8 @@ void StateMachine::process_command(Position& pos, std::string token, std::istrin
       if (is >> token)
           Options["UCI_Variant"] = token;
       setboard(pos, states);
+      startFen.clear();
+      moveList.clear();
   }
   else if (token == "force")
       playColor = COLOR_NB;
@@ -178,6 +183,8 @@ void StateMachine::process_command(Position& pos, std::string token, std::istrin
       std::string fen;
       std::getline(is >> std::ws, fen);
       setboard(pos, states, fen);
+      startFen = fen;
+      moveList.clear();
   }
   else if (token == "cores")
   {
@@ -201,7 +208,28 @@ void StateMachine::process_command(Position& pos, std::string token, std::istrin
       {
           if (Options[name].get_type() == "check")
               value = value == "1" ? "true" : "false";
+
+          int generation = ComponentGeneration;
           Options[name] = value;
+
+          // A new piece set leaves 'pos' stale, see ComponentGeneration. Set
+          // it up again and replay the game, keeping the history for repetitions.
+          if (ComponentGeneration != generation)
+          {
+              std::deque<Move> moves;
+              std::swap(moves, moveList);
+              setboard(pos, states, startFen);
+
+              for (Move m : moves)
+              {
+                  if (!MoveList<LEGAL>(pos).contains(m))
+                      break;
+
+                  moveList.push_back(m);
+                  states->emplace_back();
+                  pos.do_move(m, states->back());
+              }
+          }
       }
   }
   else if (token == "analyze")
@@ -211,7 +239,7 @@ void StateMachine::process_command(Position& pos, std::string token, std::istrin
   }
   else if (token == "exit")
   {
-      Threads.stop = true;
+      Threads.stop_search();
       Threads.main()->wait_for_search_finished();
       Options["UCI_AnalyseMode"] = std::string("false");
   }
@@ -221,7 +249,7 @@ void StateMachine::process_command(Position& pos, std::string token, std::istrin
       {
           if (Options["UCI_AnalyseMode"])
           {
-              Threads.stop = true;
+              Threads.stop_search();
               Threads.main()->wait_for_search_finished();
           }
           undo_move(pos, moveList, states);
@@ -240,6 +268,8 @@ void StateMachine::process_command(Position& pos, std::string token, std::istrin
       sync_cout << pos << sync_endl;
   else if (token == "eval")
       sync_cout << Eval::trace(pos) << sync_endl;
+  else if (token == "savehash" || token == "loadhash")
+      UCI::hash_file(token, is);
   // Move strings and unknown commands
   else
   {
@@ -248,7 +278,7 @@ void StateMachine::process_command(Position& pos, std::string token, std::istrin
           is >> token;
       if (Options["UCI_AnalyseMode"])
       {
-          Threads.stop = true;
+          Threads.stop_search();
           Threads.main()->wait_for_search_finished();
       }
       Move m;
@@ -43,6 +43,7 @@ public:
 
 private:
   std::deque<Move> moveList;
+  std::string startFen; // Of the game in moveList, empty for StartFEN
   Search::LimitsType limits;
   bool moveAfterSearch;
   Color playColor;
@@ -0,0 +1,21 @@
+#!/bin/bash
+# verify pseudo_legal() against the legal move generator in random games
+
+error()
+{
+  echo "legal testing failed on line $1"
+  exit 1
+}
+trap 'error ${LINENO}' ERR
+
+echo "legal testing started"
+
+output=`./stockfish microbench legal 2>&1`
+echo "$output" | grep "pseudo_legal mismatches"
+
+if ! echo "$output" | grep -q "pseudo_legal mismatches: 0/"; then
+   echo "$output" | grep "pseudo_legal mismatch:" | head -20
+   exit 1
+fi
+
+echo "legal testing OK"
@@ -1,9 +1,11 @@
 #!/bin/bash
-# verify perft numbers (positions from https://chessprogramming.wikispaces.com/Perft+Results)
+# verify perft numbers of Musketeer positions. Standard chess FENs are still in
+# the gate selection phase here, so the positions carry their gates.
 
 error()
 {
   echo "perft testing failed on line $1"
+  rm -f perft.exp
   exit 1
 }
 trap 'error ${LINENO}' ERR
@@ -20,12 +22,20 @@ cat << EOF > perft.exp
    expect eof
 EOF
 
-expect perft.exp startpos 5 4865609 > /dev/null
-expect perft.exp "fen r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq -" 5 193690690 > /dev/null
-expect perft.exp "fen 8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - -" 6 11030083 > /dev/null
-expect perft.exp "fen r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1" 5 15833292 > /dev/null
-expect perft.exp "fen rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8" 5 89941194 > /dev/null
-expect perft.exp "fen r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10" 5 164075551 > /dev/null
+# Musketeer positions with all gating pieces selected, exercising fairy attacks
+G="[C-L-A-M-S-D-U-H-E-F-C-L-A-M-c-l-a-m-s-d-u-h-e-f-c-l-a-m-]"
+expect perft.exp "fen r1bqkbnr/pppppppp/2c1l3/8/3U4/2H1E3/PPPPPPPP/RNBQKBNR$G w KQkq - 0 1" 4 1504702 > /dev/null
+expect perft.exp "fen 4k3/1s1d4/2f5/8/3M4/1A3L2/8/4K3$G w - - 0 1" 4 3629163 > /dev/null
+expect perft.exp "fen 4k3/8/2a5/8/3D4/1S1F4/8/4K3$G w - - 0 1" 4 736306 > /dev/null
+
+# Musketeer gating phases: selection, placement, gating on first move and gated castling
+W="L-A-M-S-D-U-H-E-F-C-L-A-M-"
+B="l-a-m-s-d-u-h-e-f-c-l-a-m-"
+expect perft.exp startpos 5 100000 > /dev/null
+expect perft.exp "fen rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR[C?L?A?M?S?D?U?H?E?F?C?L?A?M?c?l?a?m?s?d?u?h?e?f?c?l?a?m?] w KQkq - 0 1" 6 72900 > /dev/null
+expect perft.exp "fen rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR[CbLg${W:2}cblg${B:2}] w KQkq - 0 1" 5 4759741 > /dev/null
+expect perft.exp "fen r3k2r/pppppppp/8/8/8/8/PPPPPPPP/R3K2R[Ce${W}ce${B}] w KQkq - 0 1" 5 8948379 > /dev/null
+expect perft.exp "fen r3k2r/pppppppp/8/8/8/8/PPPPPPPP/R3K2R[ChLa${W:2}chla${B:2}] w KQkq - 0 1" 5 9062045 > /dev/null
 
 rm perft.exp
 
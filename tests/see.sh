@@ -0,0 +1,21 @@
+#!/bin/bash
+# verify static exchange evaluation on known exchanges and report its speed
+
+error()
+{
+  echo "see testing failed on line $1"
+  exit 1
+}
+trap 'error ${LINENO}' ERR
+
+echo "see testing started"
+
+output=`./stockfish microbench see 2>&1`
+echo "$output" | grep "SEE ns/call"
+
+if ! echo "$output" | grep -q "SEE cases failed: 0/"; then
+   echo "$output" | grep "SEE failed"
+   exit 1
+fi
+
+echo "see testing OK"